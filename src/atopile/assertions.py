@@ -2,18 +2,25 @@
 Generate a report based on assertions made in the source code.
 """
 
+import collections.abc
+import contextlib
 import itertools
+import json
 import logging
 import textwrap
+import time
 from collections import ChainMap, defaultdict
-from typing import Any, Iterable
+from pathlib import Path
+from typing import Any, Callable, Iterable, Iterator
 
+import attrs
 import pint
-import rich
+from attrs import define, field
 from eseries import eseries
 from rich.style import Style
 from rich.table import Table
-from scipy.optimize import minimize
+from scipy.optimize import OptimizeResult, minimize
+from scipy.stats import qmc
 
 from atopile import (
     address,
@@ -22,10 +29,20 @@ from atopile import (
     expressions,
     instance_methods,
     loop_soup,
+    overlay,
     parse_utils,
     telemetry,
+    utils,
+)
+from atopile.front_end import (
+    Assertion,
+    Assignment,
+    Expression,
+    Instance,
+    RangedValue,
+    lofty,
+    make_assertions,
 )
-from atopile.front_end import Assertion, Assignment, Expression, RangedValue, lofty
 
 log = logging.getLogger(__name__)
 
@@ -84,83 +101,77 @@ def generate_assertion_report(build_ctx: config.BuildContext):
     table = AssertionTable()
     context = {}
     with errors.ExceptionAccumulator() as exception_accumulator:
-        for instance_addr in instance_methods.all_descendants(build_ctx.entry):
+        for indexed in get_index(build_ctx.entry).assertions:
+            instance_addr = indexed.instance_addr
             instance = lofty.get_instance(instance_addr)
-            for assertion in instance.assertions:
-                with exception_accumulator():
-                    _try_log_assertion(assertion)
-
-                    # Build the context in which to evaluate the assertion
-                    new_symbols = {
-                        s.key for s in assertion.lhs.symbols | assertion.rhs.symbols
-                    } - context.keys()
-
-                    for symbol in new_symbols:
-                        context[symbol] = instance_methods.get_data(symbol)
-
-                    for symbol in assertion.lhs.symbols | assertion.rhs.symbols:
-                        assert symbol.key in context, f"Symbol {symbol} not found in context"
-
-                    assertion_str = parse_utils.reconstruct(assertion.src_ctx)
-
-                    instance_src = instance_addr
-                    if instance.src_ctx:
-                        instance_src += "\n (^ defined" + parse_utils.format_src_info(instance.src_ctx) + ")"
-
-                    try:
-                        a = assertion.lhs(context)
-                        b = assertion.rhs(context)
-                        passes = _do_op(a, assertion.operator, b)
-                    except (errors.AtoError, KeyError, pint.DimensionalityError) as e:
-                        table.add_row(
-                            "[red]ERROR[/]",
-                            assertion_str,
-                            "",
-                        )
-                        raise ErrorComputingAssertion(
-                            f"Exception computing assertion: {e.__class__.__name__} {str(e)}"
-                        ) from e
-
-                    assert isinstance(a, RangedValue)
-                    assert isinstance(b, RangedValue)
-                    numeric = (
-                        a.pretty_str(format_="bound") +
-                        " " + assertion.operator +
-                        " " + b.pretty_str(format_="bound")
+            assertion = indexed.assertion
+            with exception_accumulator():
+                _try_log_assertion(assertion)
+
+                # Build the context in which to evaluate the assertion
+                for symbol in indexed.symbols - context.keys():
+                    context[symbol] = instance_methods.get_data(symbol)
+
+                assertion_str = parse_utils.reconstruct(assertion.src_ctx)
+
+                instance_src = instance_addr
+                if instance.src_ctx:
+                    instance_src += "\n (^ defined" + parse_utils.format_src_info(instance.src_ctx) + ")"
+
+                try:
+                    a = assertion.lhs(context)
+                    b = assertion.rhs(context)
+                    passes = _do_op(a, assertion.operator, b)
+                except (errors.AtoError, KeyError, pint.DimensionalityError) as e:
+                    table.add_row(
+                        "[red]ERROR[/]",
+                        assertion_str,
+                        "",
+                    )
+                    raise ErrorComputingAssertion(
+                        f"Exception computing assertion: {e.__class__.__name__} {str(e)}"
+                    ) from e
+
+                assert isinstance(a, RangedValue)
+                assert isinstance(b, RangedValue)
+                numeric = (
+                    a.pretty_str(format_="bound") +
+                    " " + assertion.operator +
+                    " " + b.pretty_str(format_="bound")
+                )
+                if passes:
+                    table.add_row(
+                        "[green]PASSED[/]",
+                        assertion_str,
+                        numeric,
+                    )
+                    log.debug(
+                        textwrap.dedent(f"""
+                            Assertion [green]passed![/]
+                            address: {instance_addr}
+                            assertion: {assertion_str}
+                            numeric: {numeric}
+                        """).strip(),
+                        extra={"markup": True}
+                    )
+                else:
+                    table.add_row(
+                        "[red]FAILED[/red]",
+                        assertion_str,
+                        numeric,
+                    )
+                    raise AssertionFailed.from_ctx(
+                        assertion.src_ctx,
+                        textwrap.dedent(f"""
+                            address: $addr
+                            assertion: {assertion_str}
+                            numeric: {numeric}
+                        """).strip(),
+                        addr=instance_addr,
                     )
-                    if passes:
-                        table.add_row(
-                            "[green]PASSED[/]",
-                            assertion_str,
-                            numeric,
-                        )
-                        log.debug(
-                            textwrap.dedent(f"""
-                                Assertion [green]passed![/]
-                                address: {instance_addr}
-                                assertion: {assertion_str}
-                                numeric: {numeric}
-                            """).strip(),
-                            extra={"markup": True}
-                        )
-                    else:
-                        table.add_row(
-                            "[red]FAILED[/red]",
-                            assertion_str,
-                            numeric,
-                        )
-                        raise AssertionFailed.from_ctx(
-                            assertion.src_ctx,
-                            textwrap.dedent(f"""
-                                address: $addr
-                                assertion: {assertion_str}
-                                numeric: {numeric}
-                            """).strip(),
-                            addr=instance_addr,
-                        )
 
         # Dump the output to the console
-        rich.print(table)
+        utils.rich_print(table)
 
 
 def _do_op(a: RangedValue, op: str, b: RangedValue) -> bool:
@@ -200,52 +211,251 @@ def _check_assertion(assertion: Assertion, context: dict) -> bool:
         ) from ex
 
 
+@define
+class IndexedAssertion:
+    """An assertion, alongside the addresses of the symbols it references."""
+
+    instance_addr: address.AddrStr
+    assertion: Assertion
+    symbols: frozenset[address.AddrStr] = field(init=False)
+
+    def __attrs_post_init__(self) -> None:
+        self.refresh()
+
+    def refresh(self) -> None:
+        """Update the symbols, after the assertion's expressions are replaced."""
+        self.symbols = frozenset(
+            s.key for s in self.assertion.lhs.symbols | self.assertion.rhs.symbols
+        )
+
+
+@define
+class AssertionIndex:
+    """
+    The instances and assertions under an entry, collected in a single walk
+    of the model and shared by simplifying, solving and reporting.
+    """
+
+    root: Instance
+    # In depth-first order, like instance_methods.all_descendants
+    instance_addrs: list[address.AddrStr]
+    assertions: list[IndexedAssertion]
+
+    @classmethod
+    def from_entry(cls, entry_addr: address.AddrStr) -> "AssertionIndex":
+        """Walk the model under entry_addr."""
+        instance_addrs = []
+        indexed_assertions = []
+        for instance_addr in instance_methods.all_descendants(entry_addr):
+            instance_addrs.append(instance_addr)
+            for assertion in lofty.get_instance(instance_addr).assertions:
+                indexed_assertions.append(IndexedAssertion(instance_addr, assertion))
+        return cls(lofty.get_instance(entry_addr), instance_addrs, indexed_assertions)
+
+
+def get_index(entry_addr: address.AddrStr) -> AssertionIndex:
+    """
+    Return the index of the model under entry_addr, walking it only if
+    the model's been rebuilt since it was last indexed.
+
+    Simplifying replaces the index's assertions, so each overlay has its own.
+    """
+    index_cache = overlay.get_active().derived
+    key = (AssertionIndex, entry_addr)
+    index = index_cache.get(key)
+    if index is None or index.root is not lofty.get_instance(entry_addr):
+        index = index_cache[key] = AssertionIndex.from_entry(entry_addr)
+    return index
+
+
+def iter_source_assertions(
+    entry_addr: address.AddrStr,
+) -> Iterable[tuple[address.AddrStr, Assertion]]:
+    """
+    Iterate over the assertions under entry_addr, rebuilt from the source code.
+
+    Simplifying the expressions of a build bakes the bounds of the values
+    the assertions reference into them, which is no good for analyses that
+    need to vary those values.
+    """
+    # Chained comparisons make many assertions from a single statement
+    for instance_addr, src_ctx in dict.fromkeys(
+        (indexed.instance_addr, indexed.assertion.src_ctx)
+        for indexed in get_index(entry_addr).assertions
+    ):
+        yield from (
+            (instance_addr, assertion)
+            for assertion in make_assertions(src_ctx, instance_addr)
+        )
+
+
+class SourceContext(collections.abc.Mapping):
+    """
+    Lazily resolve addresses to their values, as written in the source code.
+
+    Expressions are evaluated in terms of the rest of the context, and
+    toleranced values are handed to `leaf` to substitute with whatever
+    the analysis in question represents them with.
+
+    Each address is resolved once, so everything referencing it
+    sees the same substitute.
+    """
+
+    def __init__(self, leaf: Callable[[address.AddrStr, RangedValue], Any]) -> None:
+        self._leaf = leaf
+        self._values: dict[address.AddrStr, Any] = {}
+        self._resolving: set[address.AddrStr] = set()
+
+    def _resolve(self, addr: address.AddrStr) -> Any:
+        value = instance_methods.get_source_data(addr)
+        if callable(value):
+            # Expressions and symbols
+            return value(self)
+        if isinstance(value, RangedValue) and value.tolerance:
+            return self._leaf(addr, value)
+        return value
+
+    def __getitem__(self, addr: address.AddrStr) -> Any:
+        if addr not in self._values:
+            if addr in self._resolving:
+                raise errors.AtoError(
+                    f"{address.get_instance_section(addr)} references itself",
+                    title="Circular dependency detected",
+                )
+            self._resolving.add(addr)
+            try:
+                self._values[addr] = self._resolve(addr)
+            finally:
+                self._resolving.discard(addr)
+        return self._values[addr]
+
+    def __iter__(self) -> Iterator[address.AddrStr]:
+        return iter(self._values)
+
+    def __len__(self) -> int:
+        return len(self._values)
+
+
+@define
+class SolverMetrics:
+    """What it took to solve a group of entangled variables."""
+
+    variables: list[address.AddrStr]
+    constraints: int
+    success: bool = False
+    # How many times the optimizer was started
+    starts: int = 0
+    iterations: int = 0
+    function_evaluations: int = 0
+    gradient_evaluations: int = 0
+    # How many combinations of E-series values were checked against the assertions
+    eseries_candidates: int = 0
+    # Whether the optimizer was started from the group's solution from the
+    # last build, in the solver cache, rather than seeded
+    cache_hits: int = 0
+    wall_time: float = 0.0
+
+
+class SolverTable(Table):
+    def __init__(self) -> None:
+        super().__init__(show_header=True, header_style="bold green", title="Solver")
+
+        self.add_column("Group")
+        self.add_column("Vars", justify="right")
+        self.add_column("Constraints", justify="right")
+        self.add_column("Iters", justify="right")
+        self.add_column("Evals (f / grad)", justify="right")
+        self.add_column("E-Series", justify="right")
+        self.add_column("Cache Hits", justify="right")
+        self.add_column("Time", justify="right")
+
+    def add(self, metrics: SolverMetrics):
+        group = address.get_instance_section(metrics.variables[0])
+        if len(metrics.variables) > 1:
+            group += f" (+{len(metrics.variables) - 1})"
+        if not metrics.success:
+            group = f"[red]{group}[/]"
+
+        super().add_row(
+            group,
+            str(len(metrics.variables)),
+            str(metrics.constraints),
+            str(metrics.iterations),
+            f"{metrics.function_evaluations} / {metrics.gradient_evaluations}",
+            str(metrics.eseries_candidates),
+            str(metrics.cache_hits),
+            f"{metrics.wall_time:.3f}s",
+            style=dark_row if len(self.rows) % 2 else light_row,
+        )
+
+
+@contextlib.contextmanager
+def _timed(metrics: SolverMetrics):
+    start = time.perf_counter()
+    try:
+        yield
+    finally:
+        metrics.wall_time = time.perf_counter() - start
+
+
+def _report_solver_metrics(
+    build_ctx: config.BuildContext, group_metrics: list[SolverMetrics]
+):
+    """Summarise the solver's metrics, and save them alongside the build's outputs."""
+    if not group_metrics:
+        return
+
+    table = SolverTable()
+    for metrics in sorted(group_metrics, key=lambda m: m.wall_time, reverse=True):
+        table.add(metrics)
+    utils.rich_print(table)
+
+    path = build_ctx.output_base.with_suffix(".solver.json")
+    path.parent.mkdir(parents=True, exist_ok=True)
+    with open(path, "w", encoding="utf-8") as f:
+        json.dump({"groups": [attrs.asdict(m) for m in group_metrics]}, f)
+
+
 def solve_assertions(build_ctx: config.BuildContext):
     """
-    Solve the assertions in the build context.
-    FIXME:
-        - This mutates the instances
+    Solve the assertions in the build context, stacking the values
+    found in the active overlay.
     """
 
+    index = get_index(build_ctx.entry)
+
     # 1. Find all the symbols referenced in assertions in the design
     # ... and figure out which are variables and which are fixed
     referenced_symbols: set[address.AddrStr] = set()
     constants: dict[address.AddrStr, Any] = {}
     variable_units: dict[str, pint.Unit] = {}
     variable_soup = loop_soup.LoopSoup()
-    for error_collector, instance_addr in errors.iter_through_errors(
-        instance_methods.all_descendants(build_ctx.entry)
-    ):
-        instance = lofty.get_instance(instance_addr)
-        for assertion in instance.assertions:
-            with error_collector(assertion.src_ctx):
-                # Bucket new symbols into variables and constants
-                assertion_symbols = {
-                    s.key for s in assertion.lhs.symbols | assertion.rhs.symbols
-                }
-                new_symbols = assertion_symbols - referenced_symbols
-                referenced_symbols |= new_symbols
-                for symbol in new_symbols:
-                    assignment = instance_methods.get_assignments(symbol)[0]
-                    if assignment.value is None:
-                        # TEMP: this is in place because our discretization strategy
-                        # requires E96 things
-                        if not assignment.unit.is_compatible_with(pint.Unit("ohm")):
-                            raise errors.AtoTypeError.from_ctx(
-                                assignment.src_ctx,
-                                f"'{symbol}' is defined, but has no value.\n"
-                                "Currently the calculator only supports resistor "
-                                "values, so please assign a value to this attribute.",
-                            )
-                        variable_units[symbol] = assignment.unit
-                        variable_soup.add(symbol)
-                    else:
-                        constants[symbol] = assignment.value
-
-                # Group up all the entangled symbols
-                variable_soup.join_multiple(
-                    filter(lambda s: s in variable_soup, assertion_symbols)
-                )
+    for error_collector, indexed in errors.iter_through_errors(index.assertions):
+        with error_collector(indexed.assertion.src_ctx):
+            # Bucket new symbols into variables and constants
+            new_symbols = indexed.symbols - referenced_symbols
+            referenced_symbols |= new_symbols
+            for symbol in new_symbols:
+                assignment = instance_methods.get_assignments(symbol)[0]
+                if assignment.value is None:
+                    # TEMP: this is in place because our discretization strategy
+                    # requires E96 things
+                    if not assignment.unit.is_compatible_with(pint.Unit("ohm")):
+                        raise errors.AtoTypeError.from_ctx(
+                            assignment.src_ctx,
+                            f"'{symbol}' is defined, but has no value.\n"
+                            "Currently the calculator only supports resistor "
+                            "values, so please assign a value to this attribute.",
+                        )
+                    variable_units[symbol] = assignment.unit
+                    variable_soup.add(symbol)
+                else:
+                    constants[symbol] = assignment.value
+
+            # Group up all the entangled symbols
+            variable_soup.join_multiple(
+                filter(lambda s: s in variable_soup, indexed.symbols)
+            )
 
     # If there isn't anything to solve, just return
     if not variable_soup:
@@ -261,19 +471,19 @@ def solve_assertions(build_ctx: config.BuildContext):
 
     # 2. Create groups of assertions based on the symbols they contain
     # This way we don't need to solve for every assertion at once
+    group_keys: dict[address.AddrStr, tuple[address.AddrStr]] = {}
+    for group in variable_soup.groups():
+        group_key = tuple(sorted(group))
+        group_keys.update(dict.fromkeys(group, group_key))
+
     assertion_groups: dict[tuple[address.AddrStr], list[dict]] = defaultdict(list)
-    for instance_addr in instance_methods.all_descendants(build_ctx.entry):
-        instance = lofty.get_instance(instance_addr)
-        for assertion in instance.assertions:
-            for symbol in assertion.lhs.symbols | assertion.rhs.symbols:
-                # Only add the constraint if the assertion contains a variable
-                # Otherwise, this assertion isn't relevant to the optimization
-                if symbol.key in variable_soup:
-                    group_key = tuple(
-                        sorted(variable_soup.get_loop(symbol.key).iter_values())
-                    )
-                    assertion_groups[group_key].append(assertion)
-                    break  # onto the next assertion
+    for indexed in index.assertions:
+        for symbol in indexed.symbols:
+            # Only add the constraint if the assertion contains a variable
+            # Otherwise, this assertion isn't relevant to the optimization
+            if symbol in group_keys:
+                assertion_groups[group_keys[symbol]].append(indexed.assertion)
+                break  # onto the next assertion
 
     # 3. Solve each group
     table = Table(show_header=True, header_style="bold green")
@@ -281,133 +491,185 @@ def solve_assertions(build_ctx: config.BuildContext):
     table.add_column("Value")
     row_count = 0
 
-    for error_collector, assertion_group in errors.iter_through_errors(assertion_groups.items()):
-        group_vars, assertions = assertion_group
-        with error_collector():
-            log.debug("Solving for group %s", group_vars)
-            translator = _translator_factory(
-                group_vars, [variable_units[addr] for addr in group_vars], constants
-            )
-
-            constraints = [
-                c for a in assertions for c in _constraint_factory(a, translator)
-            ]
+    # Start from wherever we got to last time, if we can
+    solutions_path = build_ctx.output_base.with_suffix(".solver-cache.json")
+    solutions = _load_solutions(solutions_path)
 
-            result = minimize(
-                # FIXME: see notes in _cost about how stupid this function is
-                _cost,
-                # FIXME: this single starting points is medicore at best
-                tuple(v + 10 for v in range(len(group_vars) * 2)),
-                constraints=constraints,
-                # FIXME: this should have bounds, but they'll depend on the variable's constraints
-                # We could perhaps inherit these from the variable's type?
-                bounds=[(0, None)] * len(group_vars) * 2,
-                options={
-                    "disp": log.getEffectiveLevel() <= logging.DEBUG,
-                    "maxiter": 1000,
-                },
-            )
-            log.debug("Optimization result: %s", result)
-            if not result.success:
-                title = f"Failed to solve assertions: {result.message}"
-                msg = textwrap.dedent(
-                    """
-                    The optimization algorithm failed to find a solution.
-                    This could mean a litany of things went wrong, but most likely:
-                    - The constraints are backwards / too tight
-                    - Variables are missing tolerances
-                    - Assertions conflict with one another
-                    """
+    group_metrics: list[SolverMetrics] = []
+    try:
+        for error_collector, assertion_group in errors.iter_through_errors(assertion_groups.items()):
+            group_vars, assertions = assertion_group
+            metrics = SolverMetrics(list(group_vars), 0)
+            group_metrics.append(metrics)
+            with error_collector(), _timed(metrics):
+                log.debug("Solving for group %s", group_vars)
+                translator = _translator_factory(
+                    group_vars, [variable_units[addr] for addr in group_vars], constants
                 )
 
-                msg += "\n\nVariables:\n"
-                for v in group_vars:
-                    msg += f"  {v}\n"
-                    assignment_origin = instance_methods.get_assignments(v)[0].src_ctx
-                    msg += f"    (^ assigned {parse_utils.format_src_info(assignment_origin)})\n\n"
-
-                if constants:
-                    msg += "\n\nConstants:\n"
-                    for c, v in constants.items():
-                        msg += f"  {c} = {v}\n"
-
-                msg += "\n\nAssertions:\n"
-                for a in assertions:
-                    if hasattr(a, "src_ctx") and a.src_ctx:
-                        msg += f"  {parse_utils.reconstruct(a.src_ctx)}\n"
-                    else:
-                        msg += "  Unknown Source\n"
-
-                if (
-                    len(assertions) == 1
-                    and hasattr(assertions[0], "src_ctx")
-                    and assertions[0].src_ctx
-                ):
-                    raise errors.AtoError.from_ctx(
-                        assertions[0].src_ctx,
-                        title=title,
-                        message=msg,
+                constraints = [
+                    c for a in assertions for c in _constraint_factory(a, translator)
+                ]
+                metrics.constraints = len(constraints)
+
+                def _minimize(x0) -> OptimizeResult:
+                    result = minimize(
+                        # FIXME: see notes in _cost about how stupid this function is
+                        _cost,
+                        x0,
+                        constraints=constraints,
+                        # FIXME: this should have bounds, but they'll depend on the variable's constraints
+                        # We could perhaps inherit these from the variable's type?
+                        bounds=[(0, None)] * len(group_vars) * 2,
+                        options={
+                            "disp": log.getEffectiveLevel() <= logging.DEBUG,
+                            "maxiter": 1000,
+                        },
                     )
+                    log.debug("Optimization result: %s", result)
+                    metrics.starts += 1
+                    metrics.iterations += result.get("nit", 0)
+                    metrics.function_evaluations += result.get("nfev", 0)
+                    metrics.gradient_evaluations += result.get("njev", 0)
+                    return result
+
+                # The search space is in ohms, but the variables needn't be
+                scales = [
+                    pint.Quantity(1, "ohm").to(variable_units[addr]).magnitude
+                    for addr in group_vars
+                ]
 
-                raise errors.AtoError(
-                    msg,
-                    title=title,
-                )
-
-            # Here we're attempting to shuffle the values into eseries
-            result_means = [
-                (result.x[i * 2] + result.x[i * 2 + 1]) / 2
-                for i in range(len(group_vars))
-            ]
-            for r_vals in itertools.product(
-                *[
-                    eseries.find_nearest_few(eseries.E96, x_val)
-                    for x_val in result_means
-                ],
-                repeat=1,
-            ):
-                final_values = [
-                    v
-                    for r_val in r_vals
-                    for v in [
-                        r_val - 1.1 * r_val * eseries.tolerance(eseries.E96),
-                        r_val + 1.1 * r_val * eseries.tolerance(eseries.E96),
+                bounds = _propagate_bounds(assertions, translator, scales)
+                log.debug("Propagated bounds for %s: %s", group_vars, bounds)
+
+                solution_key = _solution_key(group_vars)
+                if len(solutions.get(solution_key, ())) == len(group_vars):
+                    metrics.cache_hits = 1
+                    result = _minimize(_to_x(solutions[solution_key]))
+                else:
+                    result = _minimize(_seed_point(bounds, scales))
+
+                if not result.success:
+                    log.debug(
+                        "Retrying %s from %s more starting points",
+                        solution_key,
+                        MULTI_START_POINTS,
+                    )
+                    feasible = [
+                        r for r in map(_minimize, _multi_start_points(bounds, scales))
+                        if r.success
                     ]
+                    if feasible:
+                        result = min(feasible, key=lambda r: r.fun)
+
+                if not result.success:
+                    title = f"Failed to solve assertions: {result.message}"
+                    msg = textwrap.dedent(
+                        """
+                        The optimization algorithm failed to find a solution.
+                        This could mean a litany of things went wrong, but most likely:
+                        - The constraints are backwards / too tight
+                        - Variables are missing tolerances
+                        - Assertions conflict with one another
+                        """
+                    )
+
+                    msg += "\n\nVariables:\n"
+                    for v in group_vars:
+                        msg += f"  {v}\n"
+                        assignment_origin = instance_methods.get_assignments(v)[0].src_ctx
+                        msg += f"    (^ assigned {parse_utils.format_src_info(assignment_origin)})\n\n"
+
+                    if constants:
+                        msg += "\n\nConstants:\n"
+                        for c, v in constants.items():
+                            msg += f"  {c} = {v}\n"
+
+                    msg += "\n\nAssertions:\n"
+                    for a in assertions:
+                        if hasattr(a, "src_ctx") and a.src_ctx:
+                            msg += f"  {parse_utils.reconstruct(a.src_ctx)}\n"
+                        else:
+                            msg += "  Unknown Source\n"
+
+                    if (
+                        len(assertions) == 1
+                        and hasattr(assertions[0], "src_ctx")
+                        and assertions[0].src_ctx
+                    ):
+                        raise errors.AtoError.from_ctx(
+                            assertions[0].src_ctx,
+                            title=title,
+                            message=msg,
+                        )
+
+                    raise errors.AtoError(
+                        msg,
+                        title=title,
+                    )
+
+                # Here we're attempting to shuffle the values into eseries
+                result_means = [
+                    (result.x[i * 2] + result.x[i * 2 + 1]) / 2
+                    for i in range(len(group_vars))
                 ]
-                _context = translator(final_values)
-                if all(_check_assertion(a, _context) for a in assertions):
-                    break
-            else:
-                raise errors.AtoError(
-                    "Failed to find a solution that satisfies all the assertions using e96 values",
-                    title="Failed to solve assertions",
-                )
+                for r_vals in itertools.product(
+                    *[
+                        eseries.find_nearest_few(eseries.E96, x_val)
+                        for x_val in result_means
+                    ],
+                    repeat=1,
+                ):
+                    metrics.eseries_candidates += 1
+                    final_values = [
+                        v
+                        for r_val in r_vals
+                        for v in [
+                            r_val - 1.1 * r_val * eseries.tolerance(eseries.E96),
+                            r_val + 1.1 * r_val * eseries.tolerance(eseries.E96),
+                        ]
+                    ]
+                    _context = translator(final_values)
+                    if all(_check_assertion(a, _context) for a in assertions):
+                        break
+                else:
+                    raise errors.AtoError(
+                        "Failed to find a solution that satisfies all the assertions using e96 values",
+                        title="Failed to solve assertions",
+                    )
+                metrics.success = True
+                solutions[solution_key] = list(r_vals)
 
-            # Apply the values back to the model
-            for i, addr in enumerate(group_vars):
-                parent = lofty.get_instance(address.get_parent_instance_addr(addr))
-                name = address.get_name(addr)
+                # Apply the values back to the model
+                for i, addr in enumerate(group_vars):
+                    parent = lofty.get_instance(address.get_parent_instance_addr(addr))
+                    name = address.get_name(addr)
 
-                val = RangedValue(
-                    final_values[i * 2], final_values[i * 2 + 1], variable_units[addr]
-                )
+                    val = RangedValue(
+                        final_values[i * 2], final_values[i * 2 + 1], variable_units[addr]
+                    )
 
-                table.add_row(
-                    address.get_instance_section(addr),
-                    str(val),
-                    style=dark_row if row_count % 2 else light_row,
-                )
-                row_count += 1
+                    table.add_row(
+                        address.get_instance_section(addr),
+                        str(val),
+                        style=dark_row if row_count % 2 else light_row,
+                    )
+                    row_count += 1
 
-                # FIXME: Do we want to mutate the model here?
-                # FIXME: Creating Assignment object here is annoying
-                parent.assignments[name].appendleft(
-                    Assignment(name, value=val, given_type="None")
-                )
+                    # FIXME: Creating Assignment object here is annoying
+                    overlay.get_active().assign(
+                        parent, Assignment(name, value=val, given_type="None")
+                    )
+    finally:
+        _report_solver_metrics(build_ctx, group_metrics)
+        solutions_path.parent.mkdir(parents=True, exist_ok=True)
+        with open(solutions_path, "w", encoding="utf-8") as f:
+            json.dump(solutions, f)
 
     # Solved for assertion values
-    log.info("Values for solved variables:")
-    rich.print(table)
+    with utils.print_lock:
+        log.info("Values for solved variables:")
+        utils.rich_print(table)
 
 
 def simplify_expressions(entry_addr: address.AddrStr):
@@ -415,13 +677,16 @@ def simplify_expressions(entry_addr: address.AddrStr):
     Simplify the expressions in the build context.
     """
 
+    index = get_index(entry_addr)
+
     # Build the context to simplify everything on
-    # FIXME: I hate that we're iterating over the whole model, to grab
-    # all the context all at once and duplicated it into a dict.
+    # FIXME: I hate that we're grabbing all the context all at
+    # once and duplicating it into a dict.
     context: dict[str, expressions.NumericishTypes] = {}
-    for instance_addr in instance_methods.all_descendants(entry_addr):
+    active = overlay.get_active()
+    for instance_addr in index.instance_addrs:
         instance = lofty.get_instance(instance_addr)
-        for assignment_key, assignment in instance.assignments.items():
+        for assignment_key, assignment in active.get_all_assignments(instance).items():
             if assignment and assignment[0].value is not None:
                 context[address.add_instance(instance_addr, assignment_key)] = (
                     assignment[0].value
@@ -435,22 +700,25 @@ def simplify_expressions(entry_addr: address.AddrStr):
         parent_addr = address.get_parent_instance_addr(addr)
         name = address.get_name(addr)
         parent_instance = lofty.get_instance(parent_addr)
-        parent_instance.assignments[name].appendleft(
-            Assignment(name, value=value, given_type=None)
-        )
+        active.assign(parent_instance, Assignment(name, value=value, given_type=None))
 
     # Great, now simplify the expressions in the assertions
     # TODO:
     simplified_context = {**context, **simplified}
-    for instance_addr in instance_methods.all_descendants(entry_addr):
-        instance = lofty.get_instance(instance_addr)
-        for assertion in instance.assertions:
-            assertion.lhs = expressions.Expression.from_numericish(
+    # The model's assertions are shared with other builds, so they're replaced
+    for indexed in index.assertions:
+        assertion = indexed.assertion
+        indexed.assertion = Assertion(
+            expressions.Expression.from_numericish(
                 expressions.simplify_expression(assertion.lhs, simplified_context)
-            )
-            assertion.rhs = expressions.Expression.from_numericish(
+            ),
+            assertion.operator,
+            expressions.Expression.from_numericish(
                 expressions.simplify_expression(assertion.rhs, simplified_context)
-            )
+            ),
+            assertion.src_ctx,
+        )
+        indexed.refresh()
 
 
 def _translator_factory(
@@ -469,6 +737,130 @@ def _translator_factory(
     return _translate
 
 
+# The variables are all resistances, which are searched for between these
+# powers of ten, in ohms
+SEARCH_DECADES = (0, 7)
+
+# Width of the starting points' tolerances, as a fraction of their value
+START_TOLERANCE = 0.01
+
+# The variables' bounds are narrowed down in steps of this fraction of a decade
+BOUND_STEPS_PER_DECADE = 8
+
+# How many extra starting points to try if the first one fails
+MULTI_START_POINTS = 8
+
+# The seed is fixed so the same design always solves the same way
+MULTI_START_SEED = 0
+
+
+def _to_x(centres: Iterable[float]) -> list[float]:
+    """Return the optimizer's point for a set of variables' centre values."""
+    return [
+        v for c in centres for v in (c * (1 - START_TOLERANCE), c * (1 + START_TOLERANCE))
+    ]
+
+
+def _possible(assertion: Assertion, context: ChainMap) -> bool:
+    """
+    Return whether the assertion could hold anywhere within the ranges of the
+    values in the context, or True if it can't be evaluated over them.
+    """
+    try:
+        a = assertion.lhs(context)
+        b = assertion.rhs(context)
+        a_min, a_max, b_min, b_max = (
+            q.to_base_units().magnitude
+            for q in (a.min_qty, a.max_qty, b.min_qty, b.max_qty)
+        )
+    except (ArithmeticError, ValueError):
+        return True
+
+    if assertion.operator in ("<", "<="):
+        return a_min <= b_max
+    if assertion.operator in (">", ">="):
+        return a_max >= b_min
+    # For "within", the two sides must at least overlap
+    return a_min <= b_max and a_max >= b_min
+
+
+def _propagate_bounds(
+    assertions: list[Assertion], translator: Callable, scales: list[float]
+) -> list[tuple[float, float]]:
+    """
+    Return the powers of ten each variable's bounded between, narrowed from
+    the search space's by dropping the steps it can't be in.
+
+    Each side of the assertions is evaluated over every variable's range at
+    once, so a step's only dropped if an assertion can't hold in it, whatever
+    the other variables are. Narrowing one variable can narrow the others,
+    so this is repeated until nothing changes.
+    """
+    low, high = (decade * BOUND_STEPS_PER_DECADE for decade in SEARCH_DECADES)
+    bounds = [(low, high)] * len(scales)
+
+    def _possible_in(i: int, step: int) -> bool:
+        """Return whether the i'th variable could be in the step."""
+        context = translator(
+            [
+                10 ** (s / BOUND_STEPS_PER_DECADE) * scale
+                for j, scale in enumerate(scales)
+                for s in ((step, step + 1) if i == j else bounds[j])
+            ]
+        )
+        return all(_possible(a, context) for a in assertions)
+
+    changed = True
+    while changed:
+        changed = False
+        for i, (lo, hi) in enumerate(bounds):
+            steps = [step for step in range(lo, hi) if _possible_in(i, step)]
+            # If there's nowhere left, let the optimizer say so
+            if steps and (steps[0], steps[-1] + 1) != (lo, hi):
+                bounds[i] = (steps[0], steps[-1] + 1)
+                changed = True
+
+    return [
+        (lo / BOUND_STEPS_PER_DECADE, hi / BOUND_STEPS_PER_DECADE) for lo, hi in bounds
+    ]
+
+
+def _seed_point(bounds: list[tuple[float, float]], scales: list[float]) -> list[float]:
+    """Return a starting point with each variable in the middle of its bounds."""
+    return _to_x((10**lo + 10**hi) / 2 * scale for (lo, hi), scale in zip(bounds, scales))
+
+
+def _multi_start_points(
+    bounds: list[tuple[float, float]], scales: list[float]
+) -> list[list[float]]:
+    """
+    Return starting points spread over the variables' bounds with a
+    latin-hypercube, so each variable's tried in a different part of its
+    range for every point.
+    """
+    sampler = qmc.LatinHypercube(d=len(scales), seed=MULTI_START_SEED)
+    return [
+        _to_x(
+            10 ** (lo + (hi - lo) * u) * scale
+            for u, (lo, hi), scale in zip(point, bounds, scales)
+        )
+        for point in sampler.random(MULTI_START_POINTS)
+    ]
+
+
+def _load_solutions(path: Path) -> dict[str, list[float]]:
+    """Load the centre values each group of variables was last solved to."""
+    try:
+        with open(path, "r", encoding="utf-8") as f:
+            return json.load(f)
+    except (FileNotFoundError, json.JSONDecodeError):
+        return {}
+
+
+def _solution_key(group_vars: Iterable[address.AddrStr]) -> str:
+    return ",".join(address.get_instance_section(v) for v in group_vars)
+
+
 def _tolerance_cost(min_: float, max_: float):
     if min_ == max_:
         return 1e4
@@ -1,43 +1,65 @@
 """CLI command definition for `ato build`."""
+import hashlib
 import itertools
 import json
 import logging
-import shutil
-from typing import Callable, Optional
+import multiprocessing
+import os
+import pickle
+import threading
+from concurrent.futures import (
+    FIRST_COMPLETED,
+    Future,
+    ProcessPoolExecutor,
+    ThreadPoolExecutor,
+    wait,
+)
+from concurrent.futures.process import BrokenProcessPool
+from pathlib import Path
+from typing import Callable, ContextManager, Iterable, Optional
 
 import click
 
+import atopile.address
 import atopile.assertions
 import atopile.bom
+import atopile.components
 import atopile.config
+import atopile.consolidate
+import atopile.errors
 import atopile.front_end
 import atopile.layout
 import atopile.manufacturing_data
+import atopile.monte_carlo
 import atopile.netlist
+import atopile.overlay
+import atopile.parse
+import atopile.utils
 import atopile.variable_report
+import atopile.version
+import atopile.worst_case
 from atopile.cli.common import project_options
-from atopile.components import download_footprint
+from atopile.components import materialize_footprints
 from atopile.config import BuildContext
 from atopile.errors import ExceptionAccumulator
-from atopile.instance_methods import all_descendants, match_components
-from atopile.netlist import get_netlist_as_str
+from atopile.instance_methods import all_descendants, get_supers_list, match_components
+from atopile.netlist import write_netlist
 
 log = logging.getLogger(__name__)
 
 
 @click.command()
 @project_options
-def build(build_ctxs: list[BuildContext]):
+@click.option("--force", is_flag=True, help="Build targets even if they're up to date")
+def build(build_ctxs: list[BuildContext], force: bool):
     """
     Build the specified --target(s) or the targets specified by the build config.
     Specify the root source file with the argument SOURCE.
     eg. `ato build --target my_target path/to/source.ato:module.path`
     """
-    with ExceptionAccumulator() as err_cltr:
-        for build_ctx in build_ctxs:
-            log.info("Building %s", build_ctx.name)
-            with err_cltr():
-                _do_build(build_ctx)
+    accumulator = ExceptionAccumulator()
+    with accumulator as err_cltr:
+        _do_builds(build_ctxs, force, accumulator)
 
         with err_cltr():
             project_context = atopile.config.get_project_context()
@@ -59,16 +81,109 @@ def build(build_ctxs: list[BuildContext]):
     log.info("Build complete!")
 
 
-def _do_build(build_ctx: BuildContext) -> None:
+def solve_equations(build_ctx: BuildContext) -> None:
+    """Solve the unknown variables in a build, unless it's configured not to."""
+    if not build_ctx.dont_solve_equations:
+        atopile.assertions.simplify_expressions(build_ctx.entry)
+        atopile.assertions.solve_assertions(build_ctx)
+        atopile.assertions.simplify_expressions(build_ctx.entry)
+
+
+def _can_fork() -> bool:
+    """Return whether builds can run in processes forked from this one."""
+    return (
+        "fork" in multiprocessing.get_all_start_methods()
+        and not atopile.errors.in_debug_session()
+    )
+
+
+def _do_builds(
+    build_ctxs: list[BuildContext], force: bool, accumulator: ExceptionAccumulator
+) -> None:
+    """
+    Execute the builds, collecting their errors in accumulator.
+
+    Each design is parsed and elaborated once, up front, and shared by all
+    the builds of it. If there are several builds, and we can, they run at
+    the same time, each in a process forked from this warm one.
+    """
+    err_cltr = accumulator.make_collector()
+    elaborated = []
+    for entry in dict.fromkeys(build_ctx.entry for build_ctx in build_ctxs):
+        with err_cltr():
+            atopile.front_end.lofty.get_instance(entry)
+            elaborated.append(entry)
+
+    # Designators are written to the lock file, so they're assigned here,
+    # rather than by each build at once. If they can't be, the design's
+    # still built, and only the targets using them fail.
+    designators_cltr = accumulator.make_collector()
+    for entry in elaborated:
+        with designators_cltr():
+            atopile.components.designator_manager.get_designators(entry)
+
+    build_ctxs = [ctx for ctx in build_ctxs if ctx.entry in elaborated]
+    if len(build_ctxs) < 2 or not _can_fork():
+        for build_ctx in build_ctxs:
+            log.info("Building %s", build_ctx.name)
+            with err_cltr():
+                _do_build(build_ctx, force)
+        return
+
+    max_workers = min(len(build_ctxs), os.cpu_count() or 1)
+    with ProcessPoolExecutor(
+        max_workers, mp_context=multiprocessing.get_context("fork")
+    ) as executor:
+        futures = [
+            executor.submit(_do_build_in_process, build_ctx, force)
+            for build_ctx in build_ctxs
+        ]
+        for build_ctx, future in zip(build_ctxs, futures):
+            with err_cltr():
+                try:
+                    build_errors = future.result()
+                except BrokenProcessPool as ex:
+                    raise atopile.errors.AtoError(
+                        f"The process building {build_ctx.name} died unexpectedly",
+                        title="Build failed",
+                    ) from ex
+                # These have already been logged by the process that raised them
+                accumulator.errors.extend(build_errors)
+
+
+def _do_build_in_process(build_ctx: BuildContext, force: bool) -> list[Exception]:
+    """Execute a build in a forked process, returning the errors it raised."""
+    log.info("Building %s", build_ctx.name)
+    accumulator = ExceptionAccumulator()
+    with accumulator.make_collector()():
+        _do_build(build_ctx, force)
+
+    # Make sure the errors make it back to the parent
+    return [_picklable(error) for error in accumulator.errors]
+
+
+def _picklable(error: Exception) -> Exception:
+    """Return error, or an AtoError like it, if it can't be pickled."""
+    try:
+        pickle.dumps(error)
+    except Exception:  # pylint: disable=broad-except
+        title = getattr(error, "title", type(error).__name__)
+        return atopile.errors.AtoError(str(error), title=title)
+    return error
+
+
+def _do_build(build_ctx: BuildContext, force: bool = False) -> None:
     """Execute a specific build."""
-    with ExceptionAccumulator() as err_cltr:
+    # The values worked out for this build are kept in its own overlay,
+    # so other builds of the same design don't see them
+    with (
+        atopile.overlay.activate(atopile.overlay.Overlay()),
+        ExceptionAccumulator() as err_cltr,
+    ):
 
         # Solve the unknown variables
-        if not build_ctx.dont_solve_equations:
-            with err_cltr():
-                atopile.assertions.simplify_expressions(build_ctx.entry)
-                atopile.assertions.solve_assertions(build_ctx)
-                atopile.assertions.simplify_expressions(build_ctx.entry)
+        with err_cltr():
+            solve_equations(build_ctx)
 
         # Ensure the build directory exists
         log.info("Writing outputs to %s", build_ctx.build_path)
@@ -90,19 +205,101 @@ def _do_build(build_ctx: BuildContext) -> None:
         # Ensure the output directory exists
         build_ctx.output_base.parent.mkdir(parents=True, exist_ok=True)
 
+        # Targets are built at the same time, so make sure the
+        # design's been elaborated before they start using it
+        with err_cltr():
+            atopile.front_end.lofty.get_instance(build_ctx.entry)
+
         # Make the noise
-        built_targets = []
-        for target_name in targets:
-            log.info(f"Building '{target_name}' for '{build_ctx.name}' config")
-            with err_cltr():
-                muster.targets[target_name](build_ctx)
-            built_targets.append(target_name)
+        built_targets = muster.build(targets, build_ctx, err_cltr, force)
 
         log.info(f"Successfully built '{', '.join(built_targets)}' for '{build_ctx.name}' config")
 
 
 TargetType = Callable[[BuildContext], None]
 
+# Returns what a target reads: files, or other values its output depends
+# on. None means it's not known, so the target must always be built.
+InputsType = Callable[[BuildContext], Iterable[Path | str | None]]
+
+# Returns the files a target writes
+OutputsType = Callable[[BuildContext], Iterable[Path]]
+
+
+def _hash_file(path: Path) -> Optional[str]:
+    try:
+        return hashlib.sha256(path.read_bytes()).hexdigest()
+    except FileNotFoundError:
+        return None
+
+
+class TargetDatabase:
+    """
+    Records the hashes of the inputs and outputs targets were last built
+    with, so those whose inputs haven't changed needn't be built again.
+    """
+
+    def __init__(self, path: Path) -> None:
+        self.path = path
+        self._lock = threading.Lock()
+        try:
+            with open(path, "r", encoding="utf-8") as f:
+                self._records: dict[str, dict] = json.load(f)
+        except (FileNotFoundError, json.JSONDecodeError):
+            self._records = {}
+
+    @staticmethod
+    def hash_inputs(
+        name: str, build_ctx: BuildContext, inputs: Iterable[InputsType]
+    ) -> Optional[str]:
+        """Return a hash of a target's inputs, or None if they're not known."""
+        version = atopile.version.get_installed_atopile_version()
+        digest = hashlib.sha256(f"{version}\0{name}".encode())
+        items = itertools.chain.from_iterable(
+            get_inputs(build_ctx) for get_inputs in inputs
+        )
+        for item in sorted(items, key=lambda i: (isinstance(i, Path), str(i))):
+            if item is None:
+                return None
+            if isinstance(item, Path):
+                digest.update(f"\0{item}\0{_hash_file(item)}".encode())
+            else:
+                digest.update(f"\0{item}".encode())
+        return digest.hexdigest()
+
+    def why_outdated(
+        self, name: str, inputs_hash: str, outputs: list[Path]
+    ) -> Optional[str]:
+        """Return why a target needs building, or None if it's up to date."""
+        with self._lock:
+            record = self._records.get(name)
+        if record is None:
+            return "it hasn't been built before"
+        if record["inputs"] != inputs_hash:
+            return "its inputs have changed"
+        if sorted(record["outputs"]) != sorted(map(str, outputs)):
+            return "its outputs have changed"
+        for output in outputs:
+            if _hash_file(output) != record["outputs"][str(output)]:
+                return f"{output} is missing or has been modified"
+        return None
+
+    def record(self, name: str, inputs_hash: str, outputs: list[Path]):
+        """Record that a target's been built."""
+        record = {
+            "inputs": inputs_hash,
+            "outputs": {str(output): _hash_file(output) for output in outputs},
+        }
+        with self._lock:
+            self._records[name] = record
+
+    def save(self):
+        """Save the records for the next build."""
+        with self._lock:
+            self.path.parent.mkdir(parents=True, exist_ok=True)
+            with open(self.path, "w", encoding="utf-8") as f:
+                json.dump(self._records, f, indent=2)
+
 
 class Muster:
     """A class to register targets to."""
@@ -110,79 +307,239 @@ class Muster:
     def __init__(self, logger: Optional[logging.Logger] = None) -> None:
         self.targets = {}
         self.do_by_default = []
+        # target -> the targets it must be built after, if they're being built
+        self.after: dict[str, tuple[str, ...]] = {}
+        # target -> what it reads and writes, for those which are
+        # skipped when they're up to date
+        self.inputs: dict[str, tuple[InputsType, ...]] = {}
+        self.outputs: dict[str, OutputsType] = {}
         self.log = logger or logging.getLogger(__name__)
 
-    def add_target(self, func: TargetType, name: Optional[str] = None, default: bool = True):
-        """Register a function as a target."""
+    def add_target(
+        self,
+        func: TargetType,
+        name: Optional[str] = None,
+        default: bool = True,
+        after: Iterable[str] = (),
+        inputs: Optional[Iterable[InputsType]] = None,
+        outputs: Optional[OutputsType] = None,
+    ):
+        """
+        Register a function as a target.
+
+        Targets which declare their inputs and outputs are only built when
+        their inputs or outputs have changed since they were last built.
+        """
         name = name or func.__name__
         self.targets[name] = func
+        self.after[name] = tuple(after)
+        if inputs is not None and outputs is not None:
+            self.inputs[name] = tuple(inputs)
+            self.outputs[name] = outputs
         if default:
             self.do_by_default.append(name)
         return func
 
-    def register(self, name: Optional[str] = None, default: bool = True):
+    def register(
+        self,
+        name: Optional[str] = None,
+        default: bool = True,
+        after: Iterable[str] = (),
+        inputs: Optional[Iterable[InputsType]] = None,
+        outputs: Optional[OutputsType] = None,
+    ):
         """Register a target under a given name."""
 
         def decorator(func: TargetType):
-            self.add_target(func, name, default)
+            self.add_target(func, name, default, after, inputs, outputs)
             return func
 
         return decorator
 
+    def _build_target(
+        self,
+        name: str,
+        build_ctx: BuildContext,
+        database: Optional[TargetDatabase],
+        force: bool,
+    ) -> None:
+        inputs_hash = None
+        if database is not None and name in self.inputs:
+            inputs_hash = database.hash_inputs(name, build_ctx, self.inputs[name])
+            outputs = list(self.outputs[name](build_ctx))
+
+        if inputs_hash is not None and not force:
+            reason = database.why_outdated(name, inputs_hash, outputs)
+            if reason is None:
+                self.log.info(f"'{name}' for '{build_ctx.name}' config is up to date")
+                self.log.debug(f"Not building '{name}', its inputs are unchanged")
+                return
+            self.log.debug(f"Building '{name}', because {reason}")
+
+        self.log.info(f"Building '{name}' for '{build_ctx.name}' config")
+        self.targets[name](build_ctx)
+
+        if inputs_hash is not None:
+            database.record(name, inputs_hash, outputs)
+
+    def build(
+        self,
+        target_names: Iterable[str],
+        build_ctx: BuildContext,
+        err_cltr: Callable[[], ContextManager],
+        force: bool = False,
+    ) -> list[str]:
+        """
+        Build targets concurrently, each as soon as the targets it comes after
+        are built. Returns the names of the targets that were built.
+
+        Targets mostly wait on IO and subprocesses, so they're run on threads.
+        Their errors are collected by err_cltr, and targets which come after
+        a failed one aren't built. Targets which are up to date aren't built
+        either, unless they're forced to be.
+        """
+        target_names = list(target_names)
+        database = None
+        if any(name in self.inputs for name in target_names):
+            database = TargetDatabase(
+                build_ctx.output_base.with_suffix(".targets.json")
+            )
+
+        pending = set(target_names)
+        waiting_on = {name: set(self.after[name]) & pending for name in pending}
+        failed: set[str] = set()
+        built: list[str] = []
+        running: dict[Future, str] = {}
+
+        with ThreadPoolExecutor(thread_name_prefix="target") as executor:
+            def _start_ready_targets():
+                skipped = True
+                while skipped:
+                    # Skipping a target may mean skipping those after it too
+                    skipped = False
+                    for name in sorted(pending):
+                        if blocked_by := waiting_on[name] & failed:
+                            self.log.warning(
+                                f"Not building '{name}' for '{build_ctx.name}' config,"
+                                f" because '{', '.join(sorted(blocked_by))}' failed"
+                            )
+                            pending.remove(name)
+                            failed.add(name)
+                            skipped = True
+                        elif not waiting_on[name]:
+                            pending.remove(name)
+                            future = executor.submit(
+                                self._build_target, name, build_ctx, database, force
+                            )
+                            running[future] = name
+
+            _start_ready_targets()
+            while running:
+                done, _ = wait(running, return_when=FIRST_COMPLETED)
+                for future in done:
+                    name = running.pop(future)
+                    succeeded = False
+                    with err_cltr():
+                        future.result()
+                        succeeded = True
+
+                    if succeeded:
+                        built.append(name)
+                        for waiting in waiting_on.values():
+                            waiting.discard(name)
+                    else:
+                        failed.add(name)
+                _start_ready_targets()
+
+        if database is not None:
+            database.save()
+
+        if pending:
+            raise atopile.errors.AtoError(
+                f"Targets {', '.join(sorted(pending))} can't be built,"
+                " because they come after each other"
+            )
+
+        return built
+
 
 muster = Muster()
 
 
+def _source_files(build_ctx: BuildContext) -> Iterable[Path]:
+    """
+    The .ato files defining what's in the build's design.
+
+    Every config's design is elaborated up front, so this can't just be
+    everything that's been parsed, or editing one design would make every
+    other's targets out of date.
+    """
+    files = {atopile.address.get_file(build_ctx.entry)}
+    for addr in all_descendants(build_ctx.entry):
+        files.update(
+            atopile.address.get_file(super_.address) for super_ in get_supers_list(addr)
+        )
+    # Leaving out the built-ins, which aren't defined in a file
+    return sorted(Path(file) for file in files if file in atopile.parse.parser.cache)
+
+
+def _project_files(build_ctx: BuildContext) -> Iterable[Path]:
+    """
+    The project's config and lock files.
+
+    NOTE: designators are written to the lock file by _do_builds, before
+    any targets are built, so it's hashed as the targets leave it.
+    """
+    project_path = atopile.config.get_project_context().project_path
+    return [project_path / atopile.config.CONFIG_FILENAME, build_ctx.lock_file_path]
+
+
+def _component_selections(build_ctx: BuildContext) -> Iterable[Optional[str]]:
+    """The components selected for the design's generic components."""
+    return [atopile.components.get_selection_fingerprint(build_ctx.entry)]
+
+
 @muster.register("copy-footprints")
 def consolidate_footprints(build_args: BuildContext) -> None:
     """Consolidate all the project's footprints into a single directory."""
-    fp_target = build_args.build_path / "footprints" / "footprints.pretty"
-    fp_target_step = build_args.build_path / "footprints" / "footprints.3dshapes"
-    fp_target.mkdir(exist_ok=True, parents=True)
-
-    for fp in atopile.config.get_project_context().project_path.glob("**/*.kicad_mod"):
-        try:
-            shutil.copy(fp, fp_target)
-        except shutil.SameFileError:
-            log.debug("Footprint %s already exists in the target directory", fp)
-
-    # Post-process all the footprints in the target directory
-    for fp in fp_target.glob("**/*.kicad_mod"):
-        with open(fp, "r+", encoding="utf-8") as file:
-            content = file.read()
-            content = content.replace("{build_dir}", str(fp_target_step))
-            file.seek(0)
-            file.write(content)
-            file.truncate()
+    atopile.consolidate.consolidate_footprints(
+        atopile.config.get_project_context().project_path,
+        build_args.build_path / "footprints" / "footprints.pretty",
+        models_dir=build_args.build_path / "footprints" / "footprints.3dshapes",
+    )
 
 
 @muster.register("copy-3dmodels")
 def consolidate_3dmodels(build_args: BuildContext) -> None:
     """Consolidate all the project's 3d models into a single directory."""
-    fp_target = build_args.build_path / "footprints" / "footprints.3dshapes"
-    fp_target.mkdir(exist_ok=True, parents=True)
+    atopile.consolidate.consolidate_3dmodels(
+        atopile.config.get_project_context().project_path,
+        build_args.build_path / "footprints" / "footprints.3dshapes",
+    )
 
-    prj_path = atopile.config.get_project_context().project_path
 
-    for fp in itertools.chain(prj_path.glob("**/*.step"), prj_path.glob("**/*.wrl")):
-        try:
-            shutil.copy(fp, fp_target)
-        except shutil.SameFileError:
-            log.debug("Footprint %s already exists in the target directory", fp)
-
-
-@muster.register("netlist")
+@muster.register(
+    "netlist",
+    inputs=[_source_files, _project_files, _component_selections],
+    outputs=lambda build_ctx: [build_ctx.output_base.with_suffix(".net")],
+)
 def generate_netlist(build_args: BuildContext) -> None:
     """Generate a netlist for the project."""
-    with open(build_args.output_base.with_suffix(".net"), "w", encoding="utf-8") as f:
-        f.write(get_netlist_as_str(build_args.entry))
+    netlist_path = build_args.output_base.with_suffix(".net")
+    with atopile.utils.atomic_open(netlist_path, "w", encoding="utf-8") as f:
+        write_netlist(build_args.entry, f)
 
 
-@muster.register("bom")
+@muster.register(
+    "bom",
+    inputs=[_source_files, _project_files, _component_selections],
+    outputs=lambda build_ctx: [build_ctx.output_base.with_suffix(".csv")],
+)
 def generate_bom(build_args: BuildContext) -> None:
     """Generate a BOM for the project."""
-    with open(build_args.output_base.with_suffix(".csv"), "w", encoding="utf-8") as f:
-        f.write(atopile.bom.generate_bom(build_args.entry))
+    bom_path = build_args.output_base.with_suffix(".csv")
+    with atopile.utils.atomic_open(bom_path, "w", encoding="utf-8", newline="") as f:
+        atopile.bom.write_bom(build_args.entry, f)
 
 
 @muster.register("designator-map")
@@ -203,14 +560,13 @@ def generate_drc_report(build_ctx: BuildContext) -> None:
     atopile.manufacturing_data.generate_drc_report(build_ctx)
 
 
-@muster.register("clone-footprints")
+@muster.register("clone-footprints", after=["copy-footprints"])
 def clone_footprints(build_args: BuildContext) -> None:
     """Clone the footprints for the project."""
-    all_components = filter(match_components, all_descendants(build_args.entry))
-
-    for component in all_components:
-        log.debug("Cloning footprint for %s", component)
-        download_footprint(component, footprint_dir=build_args.build_path / "footprints/footprints.pretty")
+    materialize_footprints(
+        filter(match_components, all_descendants(build_args.entry)),
+        footprint_dir=build_args.build_path / "footprints/footprints.pretty",
+    )
 
 
 @muster.register("layout-module-map")
@@ -225,6 +581,28 @@ def generate_assertion_report(build_ctx: BuildContext) -> None:
     atopile.assertions.generate_assertion_report(build_ctx)
 
 
+@muster.register(
+    "monte-carlo",
+    default=False,
+    inputs=[_source_files, _project_files],
+    outputs=lambda build_ctx: [build_ctx.output_base.with_suffix(".monte-carlo.json")],
+)
+def generate_monte_carlo_report(build_ctx: BuildContext) -> None:
+    """Generate a report of the statistical yield of each assertion."""
+    atopile.monte_carlo.generate_monte_carlo_report(build_ctx)
+
+
+@muster.register(
+    "worst-case",
+    default=False,
+    inputs=[_source_files, _project_files],
+    outputs=lambda build_ctx: [build_ctx.output_base.with_suffix(".worst-case.json")],
+)
+def generate_worst_case_report(build_ctx: BuildContext) -> None:
+    """Generate a report of the worst-case corner of each assertion."""
+    atopile.worst_case.generate_worst_case_report(build_ctx)
+
+
 @muster.register("variable-report")
 def generate_variable_report(build_ctx: BuildContext) -> None:
     """Generate a report of all the variable values in the design."""
@@ -7,7 +7,7 @@ from rich.logging import RichHandler
 from atopile import telemetry
 from atopile.cli.rich_console import console
 
-from . import build, configure, create, inspect, install, view
+from . import build, configure, create, inspect, install, prefetch, view
 
 FORMAT = "%(message)s"
 logging.basicConfig(
@@ -69,6 +69,7 @@ cli.add_command(install.install)
 cli.add_command(configure.configure)
 cli.add_command(inspect.inspect)
 cli.add_command(view.view)
+cli.add_command(prefetch.prefetch)
 
 
 if __name__ == "__main__":
@@ -6,8 +6,12 @@ This CLI command provides the `ato install` command to:
 - download JLCPCB footprints
 """
 
+import hashlib
 import logging
+import os
 import subprocess
+import tempfile
+from concurrent.futures import ThreadPoolExecutor
 from pathlib import Path
 from typing import Optional
 from urllib.parse import urlparse
@@ -19,7 +23,7 @@ from git import InvalidGitRepositoryError, NoSuchPathError, Repo, GitCommandErro
 
 import atopile.config
 from atopile import errors, version
-from atopile.utils import robustly_rm_dir
+from atopile.utils import file_lock, robustly_rm_dir
 
 yaml = ruamel.yaml.YAML()
 
@@ -115,12 +119,22 @@ def do_install(
         config.save_changes()
 
     else:  # eg. "ato install"
-        for _ctx, dependency in errors.iter_through_errors(config.dependencies):
-            with _ctx():
-                if not dependency.link_broken:
-                    # FIXME: these dependency objects are a little too entangled
-                    dependency.path = ctx.module_path / dependency.name
-                    install_dependency(dependency, upgrade, ctx.project_path / dependency.path)
+        dependencies = [dep for dep in config.dependencies if not dep.link_broken]
+        for dependency in dependencies:
+            # FIXME: these dependency objects are a little too entangled
+            dependency.path = ctx.module_path / dependency.name
+
+        # Install them all at once, but report any errors in order
+        with ThreadPoolExecutor(max_workers=INSTALL_CONCURRENCY) as executor:
+            futures = [
+                executor.submit(
+                    install_dependency, dependency, upgrade, ctx.project_path / dependency.path
+                )
+                for dependency in dependencies
+            ]
+            for _ctx, future in errors.iter_through_errors(futures):
+                with _ctx():
+                    future.result()
 
     log.info("[green]Done![/] :call_me_hand:", extra={"markup": True})
 
@@ -149,6 +163,93 @@ def get_package_repo_from_registry(module_name: str) -> str:
     return return_url
 
 
+# Where bare mirrors of dependencies' repos are kept, for all projects
+MIRROR_DIR = Path.home() / ".atopile" / "git-mirrors"
+
+# How many dependencies to install at once
+INSTALL_CONCURRENCY = 8
+
+
+def _update_mirror(clone_url: str) -> Path:
+    """
+    Return the path to an up-to-date bare mirror of the repo at clone_url,
+    which is only fetched from the remote incrementally.
+    """
+    digest = hashlib.sha256(clone_url.encode()).hexdigest()[:16]
+    mirror_path = MIRROR_DIR / f"{digest}.git"
+
+    # Mirrors are shared by every install, in this process or another, so
+    # they're only updated holding the lock file next to them
+    with file_lock(MIRROR_DIR / f"{digest}.lock"):
+        if (mirror_path / "HEAD").exists():
+            Repo(mirror_path).git.remote("update", "--prune")
+        else:
+            # Clone alongside and move into place, so a failed clone
+            # doesn't leave a broken mirror behind
+            tmp_path = Path(tempfile.mkdtemp(dir=MIRROR_DIR, prefix=f".{digest}."))
+            try:
+                Repo.clone_from(clone_url, tmp_path, mirror=True)
+                os.replace(tmp_path, mirror_path)
+            finally:
+                if tmp_path.exists():
+                    robustly_rm_dir(tmp_path)
+
+    return mirror_path
+
+
+def _resolve_version(
+    mirror: Repo, module_name: str, module_spec: str
+) -> Optional[str]:
+    """
+    Return the name of the ref to check out to meet module_spec, or None
+    to use the default branch.
+    """
+    if "@" in module_spec:
+        # If there's an @ in the version, we're gonna check that thing out
+        return module_spec.strip(" @")
+
+    semver_to_tag = {}
+    for tag in mirror.tags:
+        try:
+            semver_to_tag[version.parse(tag.name)] = tag.name
+        except errors.AtoError:
+            log.debug(f"Tag {tag.name} is not a valid semver tag. Skipping.")
+
+    if not semver_to_tag:
+        return None
+
+    # Otherwise we're gonna find the best tag meeting the semver spec
+    valid_versions = [v for v in semver_to_tag if version.match(module_spec, v)]
+    if not valid_versions:
+        raise errors.AtoError(
+            f"No versions of {module_name} match spec {module_spec}.\n"
+            f"Available versions: {', '.join(map(str, semver_to_tag))}"
+        )
+    return semver_to_tag[max(valid_versions)]
+
+
+def _clone_from_mirror(
+    mirror_path: Path, clone_url: str, abs_path: Path, ref: Optional[str]
+) -> Repo:
+    """Clone only the commit we need from the mirror, falling back to all of them."""
+    try:
+        kwargs = {"branch": ref} if ref else {}
+        repo = Repo.clone_from(mirror_path.as_uri(), abs_path, depth=1, **kwargs)
+    except GitCommandError as ex:
+        if not ref or "already exists and is not an empty directory" in ex.stderr:
+            raise
+        # It's not a branch or tag (eg. it's a commit), so we need the history
+        # to find it. Cloning from a local path hard-links it, which is cheap.
+        if abs_path.exists():
+            robustly_rm_dir(abs_path)
+        repo = Repo.clone_from(str(mirror_path), abs_path)
+        repo.git.checkout(ref)
+
+    # Point back at the real remote, so the dependency can be worked on
+    repo.remotes.origin.set_url(clone_url)
+    return repo
+
+
 def install_dependency(
     dependency: atopile.config.Dependency,
     upgrade: bool,
@@ -168,15 +269,11 @@ def install_dependency(
         # This will raise an exception if the directory does not exist
         repo = Repo(abs_path)
     except (InvalidGitRepositoryError, NoSuchPathError):
-        # Directory does not contain a valid repo, clone into it
-        log.info(f"Installing dependency {module_name}")
-        repo = Repo.clone_from(clone_url, abs_path)
-        repo.active_branch.tracking_branch().checkout()
+        repo = None
     else:
         # In this case the directory exists and contains a valid repo
         if upgrade:
             log.info(f"Fetching latest changes for {module_name}")
-            repo.remotes.origin.fetch()
         else:
             log.info(
                 f"{module_name} already exists. If you wish to upgrade, use --upgrade"
@@ -185,48 +282,40 @@ def install_dependency(
             return
 
     # Figure out what version of this thing we need
-    semver_to_tag = {}
-    installed_semver = None
-    for tag in repo.tags:
-        try:
-            semver_to_tag[version.parse(tag.name)] = tag
-        except errors.AtoError:
-            log.debug(f"Tag {tag.name} is not a valid semver tag. Skipping.")
+    mirror_path = _update_mirror(clone_url)
+    best_checkout = _resolve_version(Repo(mirror_path), module_name, module_spec)
 
-    if "@" in module_spec:
-        # If there's an @ in the version, we're gonna check that thing out
-        best_checkout = module_spec.strip(" @")
-    elif semver_to_tag:
-        # Otherwise we're gonna find the best tag meeting the semver spec
-        valid_versions = [v for v in semver_to_tag if version.match(module_spec, v)]
-        if not valid_versions:
+    if repo is None:
+        # Directory does not contain a valid repo, clone into it
+        log.info(f"Installing dependency {module_name}")
+        repo = _clone_from_mirror(mirror_path, clone_url, abs_path, best_checkout)
+        ref_before_checkout = None
+    else:
+        # If the repo is dirty, throw an error
+        if repo.is_dirty():
             raise errors.AtoError(
-                f"No versions of {module_name} match spec {module_spec}.\n"
-                f"Available versions: {', '.join(map(str, semver_to_tag))}"
+                f"Module {module_name} has uncommitted changes. Aborting."
             )
-        installed_semver = max(valid_versions)
-        best_checkout = semver_to_tag[installed_semver]
-    else:
+
+        depth = ["--depth", "1"] if (Path(repo.git_dir) / "shallow").exists() else []
+        repo.git.fetch(
+            str(mirror_path), "--tags", "--force", *depth,
+            "+refs/heads/*:refs/remotes/origin/*",
+        )
+        ref_before_checkout = repo.head.commit
+
+    if best_checkout is None:
         log.warning(
             "No semver tags found for this module. Using latest default branch :hot_pepper:.",
             extra={"markup": True},
         )
         return None
 
-    # If the repo is dirty, throw an error
-    if repo.is_dirty():
-        raise errors.AtoError(
-            f"Module {module_name} has uncommitted changes. Aborting."
-        )
-
-    # Checkout the best thing we've found
-    ref_before_checkout = repo.head.commit
-
     # If the repo best_checkout is a branch, we need to checkout the origin/branch
-    if best_checkout in repo.heads:
-        best_checkout = f"origin/{best_checkout}"
-
-    repo.git.checkout(best_checkout)
+    if ref_before_checkout is not None:
+        if best_checkout in repo.heads:
+            best_checkout = f"origin/{best_checkout}"
+        repo.git.checkout(best_checkout)
 
     if repo.head.commit == ref_before_checkout:
         log.info(
@@ -0,0 +1,47 @@
+"""
+`ato prefetch`
+"""
+
+import logging
+
+import click
+
+import atopile.components
+import atopile.front_end
+import atopile.overlay
+from atopile.cli.build import solve_equations
+from atopile.cli.common import project_options
+from atopile.config import BuildContext
+from atopile.errors import ExceptionAccumulator
+
+log = logging.getLogger(__name__)
+
+
+@click.command()
+@project_options
+def prefetch(build_ctxs: list[BuildContext]):
+    """
+    Fill the caches the specified builds use, without building them.
+
+    Everything a build needs from the network - its components and their
+    footprints - is fetched, so the builds themselves can run from cache.
+    """
+    with ExceptionAccumulator() as err_cltr:
+        for build_ctx in build_ctxs:
+            log.info("Prefetching %s", build_ctx.name)
+            with err_cltr():
+                _do_prefetch(build_ctx)
+
+    log.info("Prefetch complete!")
+
+
+def _do_prefetch(build_ctx: BuildContext) -> None:
+    """Fill the caches for a specific build."""
+    # Elaborate the design
+    atopile.front_end.lofty.get_instance(build_ctx.entry)
+
+    # Components are selected with the solved values, so solve them first
+    with atopile.overlay.activate(atopile.overlay.Overlay()):
+        solve_equations(build_ctx)
+        count = atopile.components.prefetch(build_ctx.entry)
+    log.info("Prefetched %s generic components for '%s'", count, build_ctx.name)
@@ -1,19 +1,41 @@
+import copy
+import hashlib
 import json
 import logging
+import sqlite3
+import threading
 import time
+from concurrent.futures import Future, ThreadPoolExecutor, wait
+from contextlib import contextmanager
 from datetime import datetime, timedelta
+from email.utils import formatdate
 from functools import cache
 from pathlib import Path
-from typing import Any, Optional
+from typing import Any, Callable, Iterable, Iterator, Optional
 
 import requests
-
-from atopile import address, errors, instance_methods, config
+from attrs import define, field
+from requests.adapters import HTTPAdapter
+from ruamel.yaml import YAML
+from urllib3.util.retry import Retry
+
+from atopile import (
+    address,
+    config,
+    errors,
+    front_end,
+    instance_methods,
+    layout,
+    overlay,
+    parts_index,
+    utils,
+)
 
 from atopile.address import AddrStr
 from atopile.front_end import RangedValue
 
 log = logging.getLogger(__name__)
+yaml = YAML()
 
 
 def _get_specd_mpn(addr: AddrStr) -> str:
@@ -57,88 +79,314 @@ class NoMatchingComponent(errors.AtoError):
     title = "No component matches parameters"
 
 
-_component_cache: Optional[dict[str, Any]] = None
-def get_component_cache() -> dict[str, Any]:
+# Where components fetched from the database are kept, for all projects
+CACHE_PATH = Path.home() / ".atopile" / "component_cache.db"
+
+# How long fetched components are used for before they're fetched again
+CACHE_MAX_AGE = timedelta(days=14)
+
+# How long stale components are still used for, while they're revalidated
+# in the background, if the project allows it
+CACHE_MAX_STALE_AGE = timedelta(days=90)
+
+
+class ComponentCache:
+    """
+    Components previously fetched from the database.
+
+    Components are keyed by a hash of the spec they were fetched for, and
+    the service they were fetched from, so every instance with the same
+    spec - in this project or any other using the same service - shares
+    them.
+
+    Entries are kept in an SQLite database, so they're read one at a time
+    as they're needed and written one at a time as they're fetched. It's
+    in WAL mode, so parallel builds and the language server can share it.
+    """
+
+    # Seconds to wait for another process to finish writing
+    BUSY_TIMEOUT = 30
+
+    def __init__(self, path: Path) -> None:
+        self.path = path
+        self._local = threading.local()
+        with self._transaction() as db:
+            db.execute(
+                """
+                CREATE TABLE IF NOT EXISTS specs (
+                    key TEXT PRIMARY KEY,
+                    data TEXT NOT NULL,
+                    timestamp REAL NOT NULL,
+                    etag TEXT
+                )
+                """
+            )
+            columns = {row[1] for row in db.execute("PRAGMA table_info(specs)")}
+            if "etag" not in columns:
+                db.execute("ALTER TABLE specs ADD COLUMN etag TEXT")
+            # Which spec each component was resolved with, which was never read
+            db.execute("DROP TABLE IF EXISTS components")
+            db.execute("CREATE INDEX IF NOT EXISTS specs_timestamp ON specs (timestamp)")
+
+    @property
+    def _db(self) -> sqlite3.Connection:
+        # Connections can't be shared between threads
+        db = getattr(self._local, "db", None)
+        if db is None:
+            self.path.parent.mkdir(parents=True, exist_ok=True)
+            db = sqlite3.connect(self.path, timeout=self.BUSY_TIMEOUT, isolation_level=None)
+            db.execute("PRAGMA journal_mode=WAL")
+            db.execute("PRAGMA synchronous=NORMAL")
+            self._local.db = db
+            self._local.depth = 0
+        return db
+
+    @contextmanager
+    def _transaction(self):
+        db = self._db
+        if self._local.depth == 0:
+            db.execute("BEGIN IMMEDIATE")
+        self._local.depth += 1
+        try:
+            yield db
+        except BaseException:
+            self._local.depth -= 1
+            if self._local.depth == 0:
+                db.execute("ROLLBACK")
+            raise
+        self._local.depth -= 1
+        if self._local.depth == 0:
+            db.execute("COMMIT")
+
+    def transaction(self):
+        """Group the writes made within this context into a single commit."""
+        return self._transaction()
+
+    def get(self, spec_key: str) -> Optional[dict[str, Any]]:
+        """Return the entry for a spec, if there is one."""
+        row = self._db.execute(
+            "SELECT data, timestamp, etag FROM specs WHERE key = ?", (spec_key,)
+        ).fetchone()
+        if row is None:
+            return None
+        data, timestamp, etag = row
+        return {"data": json.loads(data), "timestamp": timestamp, "etag": etag}
+
+    def __contains__(self, spec_key: str) -> bool:
+        return self._db.execute(
+            "SELECT 1 FROM specs WHERE key = ?", (spec_key,)
+        ).fetchone() is not None
+
+    def __len__(self) -> int:
+        return self._db.execute("SELECT COUNT(*) FROM specs").fetchone()[0]
+
+    def __iter__(self) -> Iterator[str]:
+        return (key for key, in self._db.execute("SELECT key FROM specs"))
+
+    def put(self, spec_key: str, entry: dict[str, Any]):
+        """Insert or replace the entry for a spec."""
+        with self._transaction() as db:
+            db.execute(
+                "INSERT OR REPLACE INTO specs VALUES (?, ?, ?, ?)",
+                (
+                    spec_key,
+                    json.dumps(entry["data"]),
+                    entry["timestamp"],
+                    entry.get("etag"),
+                ),
+            )
+
+    def touch(self, spec_key: str, timestamp: float):
+        """Mark the entry for a spec as up to date as of timestamp."""
+        with self._transaction() as db:
+            db.execute("UPDATE specs SET timestamp = ? WHERE key = ?", (timestamp, spec_key))
+
+    def delete_older_than(self, timestamp: float) -> int:
+        """Delete entries from before timestamp, returning how many there were."""
+        with self._transaction() as db:
+            return db.execute(
+                "DELETE FROM specs WHERE timestamp < ?", (timestamp,)
+            ).rowcount
+
+    def close(self):
+        """Close this thread's connection to the database."""
+        db = getattr(self._local, "db", None)
+        if db is not None:
+            db.close()
+            self._local.db = None
+
+
+_component_cache: Optional[ComponentCache] = None
+_component_cache_lock = threading.RLock()
+
+# Projects whose old, per-project caches have been brought across
+_migrated_projects: set[Path] = set()
+
+
+def get_component_cache() -> ComponentCache:
     """Return the component cache."""
     global _component_cache
-    if _component_cache is None:
-        configure_cache()
-    return _component_cache
+    with _component_cache_lock:
+        if (
+            _component_cache is None
+            or config.get_project_context().project_path not in _migrated_projects
+        ):
+            configure_cache()
+        return _component_cache
 
 
 def configure_cache():
     """Configure the cache to be used by the component module."""
     global _component_cache
-    cache_file_path = config.get_project_context().project_path / ".ato/component_cache.json"
-    if cache_file_path.exists():
-        with open(cache_file_path, "r") as cache_file:
-                _component_cache = json.load(cache_file)
+    if _component_cache is None:
+        _component_cache = ComponentCache(CACHE_PATH)
+
+    # Bring across the entries from the per-project JSON cache we used to keep
+    project_path = config.get_project_context().project_path
+    if project_path not in _migrated_projects:
+        _migrated_projects.add(project_path)
         # Clean out stale entries
         clean_cache()
-    else:
-        _component_cache = {}
 
-def save_cache():
-    """Saves the current state of the cache to a file."""
-    cache_file_path = config.get_project_context().project_path / ".ato/component_cache.json"
-    cache_file_path.parent.mkdir(parents=True, exist_ok=True)
-    with open(cache_file_path, "w") as cache_file:
-        # Convert the ChainMap to a regular dictionary
-        serializable_cache = dict(get_component_cache())
-        json.dump(serializable_cache, cache_file)
+    legacy_path = project_path / config.ATO_DIR_NAME / "component_cache.json"
+    if not legacy_path.exists():
+        return
+
+    try:
+        with open(legacy_path, "r") as cache_file:
+            legacy_cache = json.load(cache_file)
+        with _component_cache.transaction():
+            for entry in legacy_cache.values():
+                if time.time() - entry["timestamp"] < CACHE_MAX_AGE.total_seconds():
+                    _component_cache.put(_spec_key(entry["address_data"]), entry)
+    except (json.JSONDecodeError, KeyError, TypeError, AttributeError) as ex:
+        log.debug("Ignoring unreadable component cache %s: %s", legacy_path, ex)
+    legacy_path.unlink()
 
 
 def get_component_from_cache(component_addr: AddrStr, current_data: dict) -> Optional[dict]:
-    """Retrieve a component from the cache, if available, not stale, and unchanged."""
-    # Check the cache age
-    cached_entry = get_component_cache().get(component_addr)
+    """Retrieve a component from the cache, if available and not stale."""
+    component_cache = get_component_cache()
+    spec_key = _spec_key(current_data)
+    cached_entry = component_cache.get(spec_key)
     if not cached_entry:
         return None
 
+    # Check the cache age
     cached_timestamp = datetime.fromtimestamp(cached_entry["timestamp"])
     cache_age = datetime.now() - cached_timestamp
-    if cache_age > timedelta(days=14):
-        return None
-
-    # Check the component attrs
-    if current_data != cached_entry["address_data"]:
-        return None
+    if cache_age > CACHE_MAX_AGE:
+        services = config.get_project_context().config.services
+        if not services.components_stale_while_revalidate or cache_age > CACHE_MAX_STALE_AGE:
+            return None
+        _revalidate_in_background(spec_key, current_data, cached_entry)
 
     log.debug("Using cached component for %s", component_addr)
     return cached_entry["data"]
 
 
-def update_cache(component_addr, component_data, address_data):
-    """Update the cache with new component data and save it."""
-    get_component_cache()[component_addr] = {
-        "data": component_data,
-        "timestamp": time.time(),  # Current time as a timestamp
-        "address_data": dict(address_data),  # Source attributes used to detect changes
-    }
-    save_cache()
+def update_cache(component_addr, component_data, address_data, etag=None):
+    """
+    Update the cache with new component data, and the version of it the
+    database gave, which it's revalidated against later.
+    """
+    get_component_cache().put(
+        _spec_key(address_data),
+        {
+            "data": component_data,
+            "timestamp": time.time(),  # Current time as a timestamp
+            "etag": etag,
+        },
+    )
 
 
 def clean_cache():
-    """Clean out entries older than 1 day."""
-    addrs_to_delete = set()
-    component_cache = get_component_cache()
-    for addr, entry in component_cache.items():
-        cached_timestamp = datetime.fromtimestamp(entry["timestamp"])
-        if datetime.now() - cached_timestamp >= timedelta(days=1):
-            addrs_to_delete.add(addr)
+    """Clean out entries too stale to be used."""
+    cutoff = datetime.now() - max(CACHE_MAX_AGE, CACHE_MAX_STALE_AGE)
+    get_component_cache().delete_older_than(cutoff.timestamp())
+
+
+# Revalidations run on their own thread, so builds needn't wait for them.
+# Their threads are joined as the process exits, so they do finish.
+_revalidation_executor = ThreadPoolExecutor(max_workers=2, thread_name_prefix="revalidate")
+_revalidating: dict[str, Future] = {}
+_revalidating_lock = threading.Lock()
+
+
+def _revalidate_in_background(spec_key: str, specd_data_dict: dict, cached_entry: dict):
+    """Check whether a stale component's changed in the database, without waiting."""
+    with _revalidating_lock:
+        if spec_key in _revalidating:
+            return
+        log.debug("Revalidating cached component %s", cached_entry["data"].get("lcsc_id"))
+        future = _revalidation_executor.submit(
+            _revalidate, get_component_cache(), config.get_project_context(),
+            spec_key, specd_data_dict, cached_entry,
+        )
+        _revalidating[spec_key] = future
+
+    def _done(_):
+        with _revalidating_lock:
+            _revalidating.pop(spec_key, None)
+
+    future.add_done_callback(_done)
+
+
+def _revalidate(
+    component_cache: ComponentCache,
+    project_context: config.ProjectContext,
+    spec_key: str,
+    specd_data_dict: dict,
+    cached_entry: dict,
+):
+    """
+    Check whether a stale component's changed in the database with a
+    conditional request, and update the cache with the result.
+    """
+    headers = dict(_DB_HEADERS)
+    if cached_entry.get("etag"):
+        headers["If-None-Match"] = cached_entry["etag"]
+    else:
+        headers["If-Modified-Since"] = formatdate(cached_entry["timestamp"], usegmt=True)
 
-    for addr in addrs_to_delete:
-        del component_cache[addr]
+    services = project_context.config.services
+    try:
+        response = _get_session(services.components_concurrency).post(
+            services.components, json=specd_data_dict, timeout=20, headers=headers
+        )
+        if response.status_code == 304:
+            component_cache.touch(spec_key, time.time())
+            return
+        response.raise_for_status()
+        best_component = (response.json() or {}).get("bestComponent")
+    except (requests.RequestException, ValueError) as ex:
+        # We'll try again next time it's used
+        log.debug("Failed to revalidate component: %s", ex)
+        return
 
-    save_cache()
+    if best_component:
+        component_cache.put(
+            spec_key,
+            {
+                "data": best_component,
+                "timestamp": time.time(),
+                "etag": response.headers.get("ETag"),
+            },
+        )
 
-@cache
-def _get_generic_from_db(component_addr: str) -> dict[str, Any]:
+
+def wait_for_revalidation():
+    """Wait for all the revalidations in progress to finish."""
+    with _revalidating_lock:
+        futures = list(_revalidating.values())
+    wait(futures)
+
+
+@overlay.cache
+def _get_specd_data_dict(component_addr: AddrStr) -> dict[str, Any]:
     """
-    Return the MPN for a component given its address
+    Return the spec to look up a generic component with in the components database
     """
-    log.debug("Fetching component for %s", component_addr)
-
     specd_data = instance_methods.get_data_dict(component_addr)
 
     specd_data_dict = {
@@ -169,16 +417,203 @@ def _get_generic_from_db(component_addr: str) -> dict[str, Any]:
             specd_data_dict["package"] = specd_data_dict["footprint"][1:]
             del specd_data_dict["footprint"]
 
+    return specd_data_dict
+
+
+def _spec_key(specd_data_dict: dict[str, Any]) -> str:
+    """
+    Return a key which is the same for identical specs, looked up with the
+    same components service - since other services may pick other components.
+    """
+    canonical = json.dumps(
+        [config.get_project_context().config.services.components, specd_data_dict],
+        sort_keys=True,
+        separators=(",", ":"),
+    )
+    return hashlib.sha256(canonical.encode()).hexdigest()
 
-    cached_component = get_component_from_cache(component_addr, specd_data_dict)
-    if cached_component:
-        log.debug("Using cache for %s", component_addr)
-        return cached_component
 
+_DB_HEADERS = {"accept": "application/json", "Content-Type": "application/json"}
+
+# The components service resolves many specs at once at this path,
+# which is relative to the service's URL
+BATCH_PATH = "/batch"
+
+# The most specs to send in a single batch request
+BATCH_SIZE = 500
+
+
+def _batched_entries() -> set[AddrStr]:
+    """Return the entries whose generic components this build has batch-fetched."""
+    return overlay.get_active().derived.setdefault(_batched_entries, set())
+
+
+def _unmatched_specs() -> set[str]:
+    """Return the specs this build's batch lookups found no matching component for."""
+    return overlay.get_active().derived.setdefault(_unmatched_specs, set())
+
+
+# How many times to retry requests the components database fails on its end
+RETRIES = 3
+
+# Seconds to back off between retries, which doubles with each retry
+RETRY_BACKOFF = 0.5
+
+
+@cache
+def _get_session(concurrency: int) -> requests.Session:
+    """
+    Return a session for talking to the components database, which keeps
+    connections alive between requests and retries server errors
+    """
+    retry = Retry(
+        total=RETRIES,
+        backoff_factor=RETRY_BACKOFF,
+        status_forcelist=(500, 502, 503, 504),
+        allowed_methods=None,  # Lookups are POSTs, but they're idempotent
+        raise_on_status=False,
+    )
+    adapter = HTTPAdapter(max_retries=retry, pool_maxsize=concurrency)
+
+    session = requests.Session()
+    session.mount("http://", adapter)
+    session.mount("https://", adapter)
+    return session
+
+
+def _session() -> requests.Session:
+    return _get_session(config.get_project_context().config.services.components_concurrency)
+
+
+def fetch_generics(root: AddrStr):
+    """
+    Look up all the generic components under root, which aren't already
+    cached, in as few requests to the components database as possible.
+
+    Components with identical specs are only looked up once. Anything
+    that fails here is left to be looked up individually, which is where
+    its errors are raised.
+
+    Nothing's looked up if the project picks components from a local
+    index instead.
+    """
+    if _get_parts_index() is not None:
+        return
+
+    specs: dict[str, dict[str, Any]] = {}
+    addrs_by_spec: dict[str, list[AddrStr]] = {}
+    for component_addr in filter(
+        instance_methods.match_components, instance_methods.all_descendants(root)
+    ):
+        if not _is_generic(component_addr):
+            continue
+
+        try:
+            specd_data_dict = _get_specd_data_dict(component_addr)
+        except errors.AtoError:
+            continue
+
+        if get_component_from_cache(component_addr, specd_data_dict) is not None:
+            continue
+
+        key = _spec_key(specd_data_dict)
+        if key in _unmatched_specs():
+            continue
+        specs.setdefault(key, specd_data_dict)
+        addrs_by_spec.setdefault(key, []).append(component_addr)
+
+    if not specs:
+        return
+
+    log.info("Fetching %s unique generic components", len(specs))
+    services = config.get_project_context().config.services
+    url = services.components + BATCH_PATH
+    keys = list(specs)
+    fetched: dict[str, Optional[dict]] = {}
+    etags: dict[str, Optional[str]] = {}
+    for i in range(0, len(keys), BATCH_SIZE):
+        batch = keys[i:i + BATCH_SIZE]
+        try:
+            response = _session().post(
+                url,
+                json={"components": [specs[k] for k in batch]},
+                timeout=20 + len(batch) / 10,
+                headers=_DB_HEADERS,
+            )
+            response.raise_for_status()
+            results = response.json()["components"]
+            if len(results) != len(batch):
+                raise ValueError(f"Expected {len(batch)} results, got {len(results)}")
+        except (requests.RequestException, KeyError, TypeError, ValueError) as ex:
+            log.debug("Batch fetch failed, falling back to single fetches: %s", ex)
+            break
+
+        for key, result in zip(batch, results):
+            fetched[key] = (result or {}).get("bestComponent")
+            # Batches have a version for each component, if anything
+            etags[key] = (result or {}).get("etag")
+
+    # Look up anything the batches couldn't one at a time, but concurrently
+    def _try_fetch(key: str) -> tuple[Optional[dict], Optional[str]]:
+        try:
+            return _fetch_generic(addrs_by_spec[key][0], specs[key])
+        except NoMatchingComponent:
+            return None, None
+        except errors.AtoError as ex:
+            # Leave these to be raised when the component's looked up itself
+            log.debug("Failed to fetch %s: %s", addrs_by_spec[key][0], ex)
+            return {}, None
+
+    remaining = [k for k in keys if k not in fetched]
+    if remaining:
+        with ThreadPoolExecutor(max_workers=services.components_concurrency) as executor:
+            # map returns the results in order, so everything
+            # below happens in the same order every time
+            for key, (best_component, etag) in zip(
+                remaining, executor.map(_try_fetch, remaining)
+            ):
+                fetched[key] = best_component
+                etags[key] = etag
+
+    with get_component_cache().transaction():
+        for key, best_component in fetched.items():
+            if best_component is None:
+                _unmatched_specs().add(key)
+            elif best_component:
+                for component_addr in addrs_by_spec[key]:
+                    log.info(
+                        "Fetched component %s for %s", best_component["lcsc_id"], component_addr
+                    )
+                    update_cache(
+                        component_addr, best_component, specs[key], etags.get(key)
+                    )
+
+
+_batch_lock = threading.Lock()
+
+
+def _fetch_generics_once(entry: AddrStr):
+    """
+    Fetch the generic components under entry, unless they've already
+    been fetched. Everything else waits while they are.
+    """
+    with _batch_lock:
+        batched_entries = _batched_entries()
+        if entry not in batched_entries:
+            batched_entries.add(entry)
+            fetch_generics(entry)
+
+
+def _fetch_generic(
+    component_addr: AddrStr, specd_data_dict: dict[str, Any]
+) -> tuple[Optional[dict], Optional[str]]:
+    """
+    Look up a single generic component in the components database,
+    returning it and the database's ETag for it
+    """
     url = config.get_project_context().config.services.components
-    headers = {"accept": "application/json", "Content-Type": "application/json"}
     try:
-        response = requests.post(url, json=specd_data_dict, timeout=20, headers=headers)
+        response = _session().post(url, json=specd_data_dict, timeout=20, headers=_DB_HEADERS)
         response.raise_for_status()
     except requests.HTTPError as ex:
         if ex.response.status_code == 404:
@@ -204,11 +639,58 @@ def _get_generic_from_db(component_addr: str) -> dict[str, Any]:
         ) from ex
 
     response_data = response.json() or {}
+    return response_data.get("bestComponent"), response.headers.get("ETag")
+
+
+def _get_parts_index() -> Optional[parts_index.PartsIndex]:
+    """Return the local parts index configured for this project, if there is one."""
+    project_context = config.get_project_context()
+    index_path = project_context.config.services.components_index
+    if index_path is None:
+        return None
+    return parts_index.load(project_context.project_path / Path(index_path).expanduser())
+
+
+@overlay.cache
+def _get_generic_from_db(component_addr: str) -> dict[str, Any]:
+    """
+    Return the MPN for a component given its address
+    """
+    log.debug("Fetching component for %s", component_addr)
+
+    specd_data_dict = _get_specd_data_dict(component_addr)
+
+    # A local index, if there is one, is used instead of the database
+    local_index = _get_parts_index()
+    if local_index is not None:
+        best_component = local_index.find(specd_data_dict)
+        if not best_component:
+            raise NoMatchingComponent(
+                "No valid component found in the local parts index", addr=component_addr
+            )
+        log.debug("Found component %s for %s", best_component["lcsc_id"], component_addr)
+        return best_component
+
+    cached_component = get_component_from_cache(component_addr, specd_data_dict)
+    if cached_component:
+        log.debug("Using cache for %s", component_addr)
+        return cached_component
+
+    # The first time we need a component, look up everything else
+    # we're going to need alongside it
+    _fetch_generics_once(address.get_entry(component_addr))
+    cached_component = get_component_from_cache(component_addr, specd_data_dict)
+    if cached_component:
+        return cached_component
 
-    best_component = response_data.get("bestComponent")
     # FIXME: Not returning something isn't a great mechanism to express
     # that we didn't find a component. It's not easy to distinguish between
     # a component not existing and other failure modes.
+    etag = None
+    if _spec_key(specd_data_dict) in _unmatched_specs():
+        best_component = None
+    else:
+        best_component, etag = _fetch_generic(component_addr, specd_data_dict)
     if not best_component:
         raise NoMatchingComponent("No valid component found", addr=component_addr)
 
@@ -216,7 +698,7 @@ def _get_generic_from_db(component_addr: str) -> dict[str, Any]:
     log.info("Fetched component %s for %s", lcsc, component_addr)
 
     # Now that we have a working component, update the cache with it for later
-    update_cache(component_addr, best_component, specd_data_dict)
+    update_cache(component_addr, best_component, specd_data_dict, etag)
 
     return best_component
 
@@ -229,7 +711,7 @@ class MissingData(errors.AtoError):
 
 # We cache the MPNs to ensure we select the same component if it's hit multiple times
 # in a build
-@cache
+@overlay.cache
 def get_mpn(addr: AddrStr) -> str:
     """
     Return the MPN for a component
@@ -260,7 +742,7 @@ def get_specd_value(addr: AddrStr) -> str:
 
 # Values come from the finally selected
 # component, so we need to arbitrate via that data
-@cache
+@overlay.cache
 def get_user_facing_value(addr: AddrStr) -> str:
     """
     Return a "value" of a component we can slap in things like
@@ -277,17 +759,19 @@ def get_user_facing_value(addr: AddrStr) -> str:
     return get_specd_value(addr)
 
 
-# FIXME: this function's requirements might cause a circular dependency
-def download_footprint(addr: AddrStr, footprint_dir: Path):
+# Where footprints from the database are kept, by the hash of their content
+FOOTPRINT_STORE = Path.home() / ".atopile" / "footprints"
+
+
+def _get_footprint_file(addr: AddrStr) -> Optional[tuple[str, bytes]]:
     """
-    Take the footprint from the database and make a .kicad_mod file for it
-    TODO: clean this mess up
+    Return the name and content of the footprint file for a generic
+    component, or None if it doesn't need one
     """
     if not _is_generic(addr):
-        return
+        return None
     db_data = _get_generic_from_db(addr)
 
-    # convert the footprint to a .kicad_mod file
     try:
         footprint = db_data.get("footprint_data", {})["kicad"]
     except KeyError as ex:
@@ -297,23 +781,130 @@ def download_footprint(addr: AddrStr, footprint_dir: Path):
 
     if footprint == "standard_library":
         log.debug("Footprint is standard library, skipping")
+        return None
+
+    return str(db_data.get("footprint", {}).get("kicad")), footprint.encode("utf-8")
+
+
+def _store_footprint(content: bytes) -> Path:
+    """Add a footprint to the store, returning its path there."""
+    store_path = FOOTPRINT_STORE / f"{hashlib.sha256(content).hexdigest()}.kicad_mod"
+    if not store_path.exists():
+        utils.write_if_changed(store_path, content)
+    return store_path
+
+
+def _materialize_footprint(store_path: Path, file_path: Path) -> bool:
+    """Write a footprint from the store to file_path, if it's not already there."""
+    return utils.write_if_changed(file_path, store_path.read_bytes())
+
+
+def materialize_footprints(addrs: Iterable[AddrStr], footprint_dir: Path):
+    """
+    Write .kicad_mod files for the database footprints of the components
+    at addrs.
+
+    Each footprint is written once, however many components use it, and
+    only if the file's not already up to date.
+    """
+    store_paths: dict[str, Path] = {}
+    for err_handler, addr in errors.iter_through_errors(addrs):
+        with err_handler():
+            footprint_file = _get_footprint_file(addr)
+            if footprint_file is None:
+                continue
+            file_name, content = footprint_file
+
+            try:
+                store_path = _store_footprint(content)
+            except OSError as ex:
+                raise errors.AtoInfraError("Failed to store footprint", addr=addr) from ex
+
+            if store_paths.setdefault(file_name, store_path) != store_path:
+                log.warning(
+                    "Footprint %s differs between components, using the first", file_name
+                )
+
+    if not store_paths:
         return
 
+    file_paths = [Path(footprint_dir) / file_name for file_name in store_paths]
     try:
-        file_name = db_data.get("footprint", {}).get("kicad")
-        file_path = Path(footprint_dir) / str(file_name)
+        with ThreadPoolExecutor() as executor:
+            written = sum(executor.map(_materialize_footprint, store_paths.values(), file_paths))
+    except OSError as ex:
+        raise errors.AtoInfraError(f"Failed to write footprint file: {ex}") from ex
+    log.debug("Wrote %s of %s footprints", written, len(file_paths))
 
-        # Create the directory if it doesn't exist
-        file_path.parent.mkdir(parents=True, exist_ok=True)
 
-        with open(file_path, "w") as footprint_file:
-            footprint_file.write(footprint)
-    except Exception as ex:
-        raise errors.AtoInfraError("Failed to write footprint file", addr=addr) from ex
+def prefetch(root: AddrStr) -> int:
+    """
+    Fill the caches with all the generic components under root, and their
+    footprints, returning how many components there are
+    """
+    component_addrs = [
+        addr for addr in filter(
+            instance_methods.match_components, instance_methods.all_descendants(root)
+        )
+        if _is_generic(addr)
+    ]
+
+    _fetch_generics_once(root)
+
+    # Problems with the components themselves are left for the build to report
+    get_footprint_file = errors.downgrade(_get_footprint_file, (NoMatchingComponent, MissingData))
+    for err_handler, addr in errors.iter_through_errors(component_addrs):
+        with err_handler():
+            footprint_file = get_footprint_file(addr)
+            if footprint_file is not None:
+                try:
+                    _store_footprint(footprint_file[1])
+                except OSError as ex:
+                    raise errors.AtoInfraError("Failed to store footprint", addr=addr) from ex
+
+    # Make sure anything being refreshed makes it into the cache
+    wait_for_revalidation()
+
+    return len(component_addrs)
+
+
+def get_selection_fingerprint(root: AddrStr) -> Optional[str]:
+    """
+    Return a hash of the components selected for all the generic
+    components under root, without selecting any that aren't already.
+    Returns None if any haven't been selected yet.
+    """
+    local_index = _get_parts_index()
+    digest = hashlib.sha256()
+    for addr in filter(instance_methods.match_components, instance_methods.all_descendants(root)):
+        if not _is_generic(addr):
+            continue
+        try:
+            specd_data_dict = _get_specd_data_dict(addr)
+        except errors.AtoError:
+            return None
+
+        if local_index is not None:
+            selected = local_index.find(specd_data_dict)
+        else:
+            selected = get_component_from_cache(addr, specd_data_dict)
+        if selected is None:
+            return None
+
+        digest.update(addr.encode())
+        digest.update(json.dumps(selected, sort_keys=True).encode())
+    return digest.hexdigest()
+
+
+def download_footprint(addr: AddrStr, footprint_dir: Path):
+    """
+    Take the footprint from the database and make a .kicad_mod file for it
+    """
+    materialize_footprints([addr], footprint_dir)
 
 
 # Footprints come from the users' code, so we reference that directly
-@cache
+@overlay.cache
 def get_footprint(addr: AddrStr) -> str:
     """
     Return the footprint for a component
@@ -341,7 +932,7 @@ def get_footprint(addr: AddrStr) -> str:
         ) from ex
 
 
-@cache
+@overlay.cache
 def get_package(addr: AddrStr) -> str:
     """
     Return the package for a component
@@ -356,21 +947,48 @@ def get_package(addr: AddrStr) -> str:
         raise MissingData("$addr has no package", title="No Package", addr=addr) from ex
 
 
+# The section of the lock file designators are kept in
+LOCK_DESIGNATORS_KEY = "designators"
+
+
+def _load_lock_file(lock_file_path: Path) -> dict:
+    if not lock_file_path.exists():
+        return {}
+    with lock_file_path.open("r", encoding="utf-8") as lock_file:
+        return yaml.load(lock_file) or {}
+
+
+def _lock_file_lock_path(lock_file_path: Path) -> Path:
+    """Return the path of the file lock held while updating the lock file."""
+    return lock_file_path.parent / config.ATO_DIR_NAME / (lock_file_path.name + ".lock")
+
+
+def _split_designator(designator: str) -> tuple[str, Optional[int]]:
+    """Split a designator like "R12" into its prefix and number."""
+    prefix = designator.rstrip("0123456789")
+    number = designator[len(prefix):]
+    return prefix, int(number) if number else None
+
+
 class DesignatorManager:
     """
     Ensure unique designators for all components.
+
+    Designators that aren't specified in the source are kept in the lock
+    file, so components keep theirs as the design changes around them.
     """
 
     def __init__(self) -> None:
-        self._designators: dict[AddrStr, str] = {}
+        # entry -> (the entry's instance, designators by component)
+        self._designators: dict[AddrStr, tuple[Any, dict[AddrStr, str]]] = {}
+        self._lock = threading.Lock()
 
     def _make_designators(self, root: str) -> dict[str, str]:
         designators: dict[str, str] = {}
         unnamed_components = []
         used_designators = set()
 
-        # FIXME: add lock-file data
-        # first pass: grab all the designators from the lock data
+        # first pass: grab all the designators specified in the source
         for err_handler, component in errors.iter_through_errors(filter(
             instance_methods.match_components, instance_methods.all_descendants(root)
         )):
@@ -390,27 +1008,86 @@ class DesignatorManager:
                 else:
                     unnamed_components.append(component)
 
-        # second pass: assign designators to the unnamed components
-        for component in unnamed_components:
+        def _get_prefix(component: AddrStr) -> str:
             try:
-                prefix = instance_methods.get_data(component, "designator_prefix")
+                return instance_methods.get_data(component, "designator_prefix")
             except KeyError:
-                prefix = "U"
-
-            i = 1
-            while f"{prefix}{i}" in used_designators:
-                i += 1
-
-            designators[component] = f"{prefix}{i}"
-            used_designators.add(designators[component])
+                return "U"
+
+        # The lock file's held from reading it to writing it back, so
+        # concurrent builds, or the language server, don't lose each
+        # other's designators
+        project_path = config.get_project_context().project_path
+        lock_file_path = config.get_project_context().lock_file_path
+        with utils.file_lock(_lock_file_lock_path(lock_file_path)):
+            # second pass: reuse the designators in the lock file, where
+            # they're still valid
+            lock_data = _load_lock_file(lock_file_path)
+            locked = lock_data.get(LOCK_DESIGNATORS_KEY) or {}
+
+            def _lock_key(component: AddrStr) -> str:
+                try:
+                    return address.get_relative_addr_str(component, project_path)
+                except ValueError:
+                    # Outside the project
+                    return component
+
+            still_unnamed = []
+            for component in unnamed_components:
+                designator = locked.get(_lock_key(component))
+                if (
+                    designator
+                    and designator not in used_designators
+                    and _split_designator(designator)[0] == _get_prefix(component)
+                ):
+                    used_designators.add(designator)
+                    designators[component] = designator
+                else:
+                    still_unnamed.append(component)
+
+            # third pass: assign designators to the rest, counting up from
+            # the lowest free number for each prefix
+            next_numbers: dict[str, int] = {}
+            for component in still_unnamed:
+                prefix = _get_prefix(component)
+                i = next_numbers.get(prefix, 1)
+                while f"{prefix}{i}" in used_designators:
+                    i += 1
+                next_numbers[prefix] = i + 1
+
+                designators[component] = f"{prefix}{i}"
+                used_designators.add(designators[component])
+
+            # Save the designators we've assigned, replacing those of any
+            # components which have since been removed
+            root_key = _lock_key(root)
+            new_locked = {
+                k: v for k, v in locked.items()
+                if k != root_key and not k.startswith(root_key + "::")
+            }
+            new_locked.update(
+                (_lock_key(component), designators[component])
+                for component in unnamed_components
+            )
+            if new_locked != locked:
+                lock_data[LOCK_DESIGNATORS_KEY] = dict(sorted(new_locked.items()))
+                with utils.atomic_open(lock_file_path, encoding="utf-8") as lock_file:
+                    yaml.dump(lock_data, lock_file)
 
         return designators
 
-    def get_designator(self, addr: str) -> str:
+    def get_designators(self, entry: str) -> dict[str, str]:
         """Return a mapping of instance address to designator."""
-        if addr not in self._designators:
-            self._designators = self._make_designators(address.get_entry(addr))
-        return self._designators[addr]
+        with self._lock:
+            # Designators are only worked out again when the model's rebuilt
+            root = front_end.lofty.get_instance(entry)
+            if entry not in self._designators or self._designators[entry][0] is not root:
+                self._designators[entry] = (root, self._make_designators(entry))
+            return self._designators[entry][1]
+
+    def get_designator(self, addr: str) -> str:
+        """Return the designator for a component."""
+        return self.get_designators(address.get_entry(addr))[addr]
 
 
 designator_manager = DesignatorManager()
@@ -421,3 +1098,91 @@ def get_designator(addr: str) -> str:
     Return the designator for a component
     """
     return designator_manager.get_designator(addr)
+
+
+@define
+class ComponentAttributes:
+    """
+    The attributes of a component which a build's outputs are made from.
+
+    Each's looked up the first time it's used, so outputs only pay for
+    what they use. Errors looking them up are kept, and raised wherever
+    the attribute's used, so each output handles them the way it always has.
+    """
+
+    addr: AddrStr
+    uid: str
+    _looked_up: dict[str, Any] = field(factory=dict)
+
+    @classmethod
+    def look_up(cls, addr: AddrStr) -> "ComponentAttributes":
+        """Make the attributes of the component at addr, to look up as they're used."""
+        return cls(addr, layout.generate_comp_uid(addr))
+
+    def _get(self, name: str) -> Any:
+        if name not in self._looked_up:
+            try:
+                looked_up = _ATTRIBUTE_GETTERS[name](self.addr)
+            except errors.AtoError as ex:
+                looked_up = ex
+            # If another thread beat us to it, everyone uses what it found
+            self._looked_up.setdefault(name, looked_up)
+
+        value = self._looked_up[name]
+        if isinstance(value, errors.AtoError):
+            # Raise a copy, because raising the error adds to its traceback,
+            # and that'd be shared by every thread raising it
+            raise copy.copy(value).with_traceback(value.__traceback__)
+        return value
+
+    @property
+    def designator(self) -> str:
+        return self._get("designator")
+
+    @property
+    def footprint(self) -> str:
+        return self._get("footprint")
+
+    @property
+    def mpn(self) -> str:
+        return self._get("mpn")
+
+    @property
+    def value(self) -> str:
+        return self._get("value")
+
+    @property
+    def package(self) -> str:
+        return self._get("package")
+
+
+_ATTRIBUTE_GETTERS: dict[str, Callable[[AddrStr], Any]] = {
+    "designator": get_designator,
+    "footprint": get_footprint,
+    "mpn": get_mpn,
+    "value": get_user_facing_value,
+    "package": get_package,
+}
+
+_component_table_lock = threading.Lock()
+
+
+def get_component_table(entry: AddrStr) -> dict[AddrStr, ComponentAttributes]:
+    """
+    Return the attributes of all the components under entry, in the order
+    they're in the design, which are looked up once for all the build's
+    outputs.
+    """
+    key = (ComponentAttributes, entry)
+    derived = overlay.get_active().derived
+    # The targets using this are built at the same time
+    with _component_table_lock:
+        if key not in derived:
+            derived[key] = {
+                addr: ComponentAttributes.look_up(addr)
+                for addr in filter(
+                    instance_methods.match_components,
+                    instance_methods.all_descendants(entry),
+                )
+            }
+        return derived[key]
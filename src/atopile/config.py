@@ -10,7 +10,7 @@ from typing import Optional
 
 import cattrs
 import deepdiff
-from attrs import Factory, define
+from attrs import Factory, define, field, validators
 from ruamel.yaml import YAML
 
 import atopile.errors
@@ -52,12 +52,22 @@ class ProjectBuildConfig:
     exclude_targets: list[str] = Factory(list)
     fail_on_drcs: bool = False
     dont_solve_equations: bool = False
+    monte_carlo_samples: int = field(default=100_000, validator=validators.ge(1))
+    monte_carlo_distribution: str = field(
+        default="uniform", validator=validators.in_(("uniform", "gaussian"))
+    )
 
 
 @define
 class ProjectServicesConfig:
     """A config for services used by the project."""
     components: str = "https://component-server-3033-5335559d-kjaci698.onporter.run/jlc/v1"
+    # How many components to look up at once, when they can't be batched
+    components_concurrency: int = field(default=8, validator=validators.ge(1))
+    # Whether to keep using stale components while they're refreshed in the background
+    components_stale_while_revalidate: bool = False
+    # A local parts index to select components from instead, without the network
+    components_index: Optional[Path] = None
 
 
 @define
@@ -125,6 +135,12 @@ class ProjectConfig:
             for ex in exs.exceptions:
                 # FIXME: make this less shit
                 raise AtoConfigError(f"Bad key in config {repr(ex)}") from ex
+        except* ValueError as exs:
+            # cattrs nests its errors by class, with the validators' at the bottom
+            ex = exs
+            while isinstance(ex, BaseExceptionGroup):
+                ex = ex.exceptions[0]
+            raise AtoConfigError(f"Bad value in config: {ex}") from ex
 
     def patch_config(self, original: dict) -> dict:
         """Apply a delta between the original and the current config."""
@@ -309,6 +325,8 @@ class BuildContext:
     exclude_targets: list[str]
     fail_on_drcs: bool
     dont_solve_equations: bool
+    monte_carlo_samples: int
+    monte_carlo_distribution: str
 
     layout_path: Optional[Path]  # eg. path/to/project/layouts/default/default.kicad_pcb
     lock_file_path: Optional[Path]  # eg. path/to/project/ato-lock.yaml
@@ -336,6 +354,8 @@ class BuildContext:
             exclude_targets=build_config.exclude_targets,
             fail_on_drcs=build_config.fail_on_drcs,
             dont_solve_equations=build_config.dont_solve_equations,
+            monte_carlo_samples=build_config.monte_carlo_samples,
+            monte_carlo_distribution=build_config.monte_carlo_distribution,
             layout_path=find_layout(project_context.project_path / project_context.layout_path / config_name),
             lock_file_path=project_context.project_path / LOCK_FILE_NAME,
             build_path=build_path,
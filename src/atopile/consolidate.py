@@ -0,0 +1,185 @@
+"""
+Consolidate a project's footprints and 3D models into its build directory.
+
+Syncing is incremental: a manifest alongside the consolidated files records
+the source each came from, and the size and mtime of both. Files are only
+copied again once either side's changed. Files whose sources are gone are
+removed.
+
+3D models are big, so they're reflinked or hardlinked into place where
+the filesystem allows, rather than copied.
+"""
+
+import errno
+import json
+import logging
+import os
+import shutil
+import sys
+import tempfile
+from pathlib import Path
+from typing import Callable, Iterable, Optional
+
+from atopile import config, utils
+
+log = logging.getLogger(__name__)
+
+
+MANIFEST_NAME = ".manifest.json"
+LOCK_NAME = ".manifest.lock"
+
+# Directories which are never searched for files to consolidate
+_PRUNED_DIRS = {config.BUILD_DIR_NAME, ".git", "node_modules", "__pycache__"}
+
+# Linux's ioctl to share a file's data with another, on filesystems which can
+_FICLONE = 0x40049409
+
+
+def find_files(root: Path, suffixes: Iterable[str]) -> list[Path]:
+    """
+    Return the files under root with any of the suffixes, in a stable order.
+
+    Build directories, which is where things are consolidated to, aren't
+    searched, and nor are other directories which never hold sources.
+    """
+    suffixes = tuple(suffixes)
+    found = []
+    for dir_path, dir_names, file_names in os.walk(root):
+        dir_names[:] = sorted(d for d in dir_names if d not in _PRUNED_DIRS)
+        found.extend(
+            Path(dir_path) / name for name in sorted(file_names) if name.endswith(suffixes)
+        )
+    return found
+
+
+def _stat_key(path: Path) -> Optional[list[int]]:
+    try:
+        stat = path.stat()
+    except FileNotFoundError:
+        return None
+    return [stat.st_size, stat.st_mtime_ns]
+
+
+def _reflink(src: Path, dst: Path) -> None:
+    """Make dst share src's data, without copying it."""
+    import fcntl  # pylint: disable=import-outside-toplevel
+
+    with open(src, "rb") as src_f, open(dst, "wb") as dst_f:
+        fcntl.ioctl(dst_f.fileno(), _FICLONE, src_f.fileno())
+
+
+def link_or_copy(src: Path, dst: Path) -> None:
+    """
+    Put src's content at dst, as cheaply as the filesystem allows: with
+    a reflink, then a hardlink, and only otherwise a copy.
+    """
+    fd, tmp_name = tempfile.mkstemp(dir=dst.parent, prefix=f".{dst.name}.")
+    os.close(fd)
+    tmp_path = Path(tmp_name)
+    try:
+        try:
+            if not sys.platform.startswith("linux"):
+                raise OSError(errno.EOPNOTSUPP, "Reflinks are only tried on Linux")
+            _reflink(src, tmp_path)
+            # Otherwise it's as owner-only as the temporary file was
+            shutil.copymode(src, tmp_path)
+        except OSError:
+            tmp_path.unlink()
+            try:
+                os.link(src, tmp_path)
+            except OSError:
+                shutil.copy2(src, tmp_path)
+        os.replace(tmp_path, dst)
+    except BaseException:
+        tmp_path.unlink(missing_ok=True)
+        raise
+
+
+def sync(
+    sources: Iterable[Path],
+    target_dir: Path,
+    put: Callable[[Path, Path], None],
+    variant: str = "",
+) -> int:
+    """
+    Sync the sources into target_dir with put(src, dst), returning how many
+    were put there.
+
+    Sources sharing a name are put there in order, so the last one wins.
+    variant is anything else that changes what put writes, which means
+    everything's put there again when it changes.
+
+    Builds running at the same time share the build directory, so they
+    take turns syncing into it.
+    """
+    with utils.file_lock(target_dir / LOCK_NAME):
+        return _sync(sources, target_dir, put, variant)
+
+
+def _sync(
+    sources: Iterable[Path],
+    target_dir: Path,
+    put: Callable[[Path, Path], None],
+    variant: str,
+) -> int:
+    manifest_path = target_dir / MANIFEST_NAME
+    try:
+        with open(manifest_path, "r", encoding="utf-8") as f:
+            manifest: dict[str, dict] = json.load(f)
+    except (FileNotFoundError, json.JSONDecodeError):
+        manifest = {}
+
+    latest = {src.name: src for src in sources}
+
+    new_manifest = {}
+    put_count = 0
+    for name, src in sorted(latest.items()):
+        dst = target_dir / name
+        record = manifest.get(name, {})
+        src_key = _stat_key(src)
+        if (
+            record.get("source") == str(src)
+            and record.get("source_stat") == src_key
+            and record.get("variant") == variant
+            and record.get("stat") == _stat_key(dst)
+        ):
+            new_manifest[name] = record
+            continue
+
+        put(src, dst)
+        put_count += 1
+        new_manifest[name] = {
+            "source": str(src),
+            "source_stat": src_key,
+            "variant": variant,
+            "stat": _stat_key(dst),
+        }
+
+    # Remove what we put here before, whose sources are gone
+    for name in manifest.keys() - new_manifest.keys():
+        (target_dir / name).unlink(missing_ok=True)
+
+    utils.write_if_changed(
+        manifest_path, json.dumps(new_manifest, indent=2, sort_keys=True).encode()
+    )
+    log.debug("Synced %s of %s files into %s", put_count, len(latest), target_dir)
+    return put_count
+
+
+def consolidate_footprints(project_path: Path, target_dir: Path, models_dir: Path):
+    """
+    Consolidate the project's footprints into target_dir, pointing them at
+    the 3D models consolidated into models_dir.
+    """
+
+    def _put(src: Path, dst: Path):
+        content = src.read_text(encoding="utf-8")
+        content = content.replace("{build_dir}", str(models_dir))
+        utils.write_if_changed(dst, content.encode("utf-8"))
+
+    sync(find_files(project_path, [".kicad_mod"]), target_dir, _put, str(models_dir))
+
+
+def consolidate_3dmodels(project_path: Path, target_dir: Path):
+    """Consolidate the project's 3D models into target_dir."""
+    sync(find_files(project_path, [".step", ".wrl"]), target_dir, link_or_copy)
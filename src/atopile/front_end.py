@@ -680,10 +680,12 @@ class Roley(HandlesPrimaries):
         """Parse a functional expression."""
         if ctx.name():
             name = ctx.name().getText()
+            # Dispatch on the value, so subclasses of RangedValue
+            # used in analyses can provide their own implementations
             if name == "min":
-                func = expressions.RangedValue.min
+                func = operator.methodcaller("min")
             elif name == "max":
-                func = expressions.RangedValue.max
+                func = operator.methodcaller("max")
             else:
                 raise errors.AtoNotImplementedError(f"Unknown function '{name}'")
 
@@ -707,6 +709,56 @@ class Roley(HandlesPrimaries):
         raise ValueError
 
 
+def make_assertions(ctx: ap.Assert_stmtContext, instance_addr: AddrStr) -> list[Assertion]:
+    """
+    Build the assertions in an assert statement, in the context of an instance.
+
+    This is split out of Lofty so the assertions can be rebuilt from their
+    source, without any of the simplifications applied to them during a build.
+    """
+    comparison_ctx: ap.ComparisonContext = ctx.comparison()
+    roley = Roley(instance_addr)
+
+    expressions_ = []
+    operators = []
+
+    def _add_expr_from_context(ctx: ap.Arithmetic_expressionContext):
+        expr = Expression.from_numericish(
+            roley.visit(ctx)
+        )
+        # TODO: this shouldn't be attached to the expression like this
+        # as the only means to pretty-print them
+        expr.src_ctx = ctx
+        expressions_.append(expr)
+
+    _add_expr_from_context(comparison_ctx.arithmetic_expression())
+
+    for comp_ctx in comparison_ctx.compare_op_pair():
+        assert isinstance(comp_ctx, ap.Compare_op_pairContext)
+        if child_ctx := comp_ctx.lt_arithmetic_or():
+            operators.append("<")
+        elif child_ctx := comp_ctx.gt_arithmetic_or():
+            operators.append(">")
+        elif child_ctx := comp_ctx.lt_eq_arithmetic_or():
+            operators.append("<=")
+        elif child_ctx := comp_ctx.gt_eq_arithmetic_or():
+            operators.append(">=")
+        elif child_ctx := comp_ctx.in_arithmetic_or():
+            operators.append("within")
+        else:
+            raise ValueError
+        _add_expr_from_context(child_ctx.arithmetic_expression())
+
+    assert len(expressions_) == len(operators) + 1
+
+    return [Assertion(
+        src_ctx=ctx,
+        lhs=expressions_[i],
+        operator=operators[i],
+        rhs=expressions_[i+1],
+    ) for i in range(len(operators))]
+
+
 class Scoop(HandleStmtsFunctional, HandlesPrimaries):
     """Scoop's job is to map out all the object definitions in the code."""
 
@@ -1408,49 +1460,9 @@ class Lofty(HandleStmtsFunctional, HandlesPrimaries, HandlesGetTypeInfo):
 
     def visitAssert_stmt(self, ctx: ap.Assert_stmtContext) -> KeyOptMap:
         """Handle assertion statements."""
-        comparison_ctx: ap.ComparisonContext = ctx.comparison()
-        roley = Roley(self._instance_addr_stack.top)
-
-        expressions_ = []
-        operators = []
-
-        def _add_expr_from_context(ctx: ap.Arithmetic_expressionContext):
-            expr = Expression.from_numericish(
-                roley.visit(ctx)
-            )
-            # TODO: this shouldn't be attached to the expression like this
-            # as the only means to pretty-print them
-            expr.src_ctx = ctx
-            expressions_.append(expr)
-
-        _add_expr_from_context(comparison_ctx.arithmetic_expression())
-
-        for comp_ctx in comparison_ctx.compare_op_pair():
-            assert isinstance(comp_ctx, ap.Compare_op_pairContext)
-            if child_ctx := comp_ctx.lt_arithmetic_or():
-                operators.append("<")
-            elif child_ctx := comp_ctx.gt_arithmetic_or():
-                operators.append(">")
-            elif child_ctx := comp_ctx.lt_eq_arithmetic_or():
-                operators.append("<=")
-            elif child_ctx := comp_ctx.gt_eq_arithmetic_or():
-                operators.append(">=")
-            elif child_ctx := comp_ctx.in_arithmetic_or():
-                operators.append("within")
-            else:
-                raise ValueError
-            _add_expr_from_context(child_ctx.arithmetic_expression())
-
-        assert len(expressions_) == len(operators) + 1
-
-        assertions_ = [Assertion(
-            src_ctx=ctx,
-            lhs=expressions_[i],
-            operator=operators[i],
-            rhs=expressions_[i+1],
-        ) for i in range(len(operators))]
-
-        self._current_instance.assertions.extend(assertions_)
+        self._current_instance.assertions.extend(
+            make_assertions(ctx, self._instance_addr_stack.top)
+        )
 
         return KeyOptMap.empty()
 
@@ -1,6 +1,6 @@
-from typing import Any, Callable, Iterable, Optional
+from typing import Any, Callable, Collection, Iterable, Optional
 
-from atopile import address, errors
+from atopile import address, errors, overlay
 from atopile.address import AddrStr
 from atopile.front_end import ClassLayer, Link, lofty, Instance, Assignment
 
@@ -15,7 +15,10 @@ def get_children(addr: str) -> Iterable[AddrStr]:
 def get_data_dict(addr: str) -> dict[str, Any]:
     """Return the data at the given address"""
     instance = lofty.get_instance(addr)
-    return {k: v[0].value for k, v in instance.assignments.items()}
+    return {
+        k: v[0].value
+        for k, v in overlay.get_active().get_all_assignments(instance).items()
+    }
 
 
 def _split_parent_and_key(addr: str) -> tuple[str, Optional[str]]:
@@ -37,7 +40,7 @@ def get_assignments(addr: str, key: Optional[str] = None) -> list[Assignment]:
     if key not in parent_inst.assignments:
         raise errors.AtoKeyError(f"{parent_inst} has no attribute {key}")
 
-    return parent_inst.assignments[key]
+    return overlay.get_active().get_assignments(parent_inst, key)
 
 
 def get_data(addr: str, key: Optional[str] = None) -> Any:
@@ -48,6 +51,25 @@ def get_data(addr: str, key: Optional[str] = None) -> Any:
     raise errors.AtoKeyError(f"{addr} is declared, but has no value for {key}")
 
 
+def get_source_data(addr: str, key: Optional[str] = None) -> Any:
+    """
+    Return the data assigned at the given address in the source code
+
+    Simplifying and solving stack their results on top of the source's
+    assignments. Where something's declared, but not assigned in the
+    source, the value stacked on top of it is returned instead.
+    """
+    assignments = get_assignments(addr, key)
+    for assignment in assignments:
+        if assignment.src_ctx is None:
+            # This was stacked on during the build
+            continue
+        if assignment.value is not None:
+            return assignment.value
+        break
+    return get_data(addr, key)
+
+
 def all_descendants(addr: str) -> Iterable[str]:
     """
     Return a list of addresses in depth-first order
@@ -113,15 +135,17 @@ match_sentinels = _make_dumb_matcher(
 
 
 def find_matching_super(
-    addr: AddrStr, candidate_supers: list[AddrStr]
+    addr: AddrStr, candidate_supers: Collection[AddrStr]
 ) -> Optional[AddrStr]:
     """
-    Return the first super of addr, is in the list of
-    candidate_supers, or None if none are.
+    Return the first super of addr, is in the candidate_supers,
+    or None if none are.
+
+    Pass a set or dict to check against lots of candidates.
     """
     supers = get_supers_list(addr)
     for duper in supers:
-        if any(duper.address == pt for pt in candidate_supers):
+        if duper.address in candidate_supers:
             return duper.address
     return None
 
@@ -6,17 +6,28 @@ Thanks @nickkrstevski (https://github.com/nickkrstevski) for
 the heavy lifting on this one!
 """
 
+import functools
 import hashlib
 import json
 import logging
 import uuid
 from collections import defaultdict
-
-from atopile import address, config, errors, instance_methods
+from pathlib import Path
+from typing import Optional
+
+from attrs import define
+
+from atopile import (
+    address,
+    components,
+    config,
+    consolidate,
+    errors,
+    utils,
+)
 from atopile.instance_methods import (
     all_descendants,
     find_matching_super,
-    match_components,
     match_modules,
 )
 
@@ -30,6 +41,7 @@ def generate_uuid_from_string(path: str) -> str:
     return str(uuid.UUID(bytes=hashed_path))
 
 
+@functools.cache
 def generate_comp_uid(comp_addr: str) -> str:
     """Get a unique identifier for a component."""
     instance_section = address.get_instance_section(comp_addr)
@@ -38,23 +50,104 @@ def generate_comp_uid(comp_addr: str) -> str:
     return generate_uuid_from_string(instance_section)
 
 
-def _find_module_layouts() -> dict[str, list[config.BuildContext]]:
+# Where the index of the project's laid out modules is kept
+LAYOUT_INDEX_PATH = Path(config.ATO_DIR_NAME) / "layout-index.json"
+
+
+@define
+class LaidOutModule:
+    """A build of a module in the project, whose layout can be reused."""
+
+    name: str
+    entry: address.AddrStr
+    layout_base: Path
+
+    @property
+    def layout_path(self) -> Optional[Path]:
+        """The build's layout, found when it's needed."""
+        return config.find_layout(self.layout_base)
+
+
+def _index_config(config_path: Path) -> dict[str, dict[str, str]]:
+    """Return the entry and layout base of each of a config's builds."""
+    # Not the loaded config, which may be from before the file changed
+    cfg = config.ProjectConfig.load(config_path)
+    project_context = config.ProjectContext.from_config(cfg)
+    return {
+        build_name: {
+            "entry": address.AddrStr(project_context.project_path / build_config.entry),
+            "layout_base": str(
+                project_context.project_path / project_context.layout_path / build_name
+            ),
+        }
+        for build_name, build_config in cfg.builds.items()
+    }
+
+
+def _index_module_layouts(project_path: Path) -> dict[str, list[LaidOutModule]]:
     """
-    Return a dict of all the known entry points of dependencies in the project.
-    The dict maps the entry point's address to another map of the entry point's
-    build name and the layout file path.
+    Index the builds of every config in the project, by their entry points.
+
+    What's found in each config is kept in an index in the project, so
+    configs are only parsed again once they've changed.
     """
-    directory = config.get_project_context().project_path
+    index_path = project_path / LAYOUT_INDEX_PATH
+    try:
+        with open(index_path, "r", encoding="utf-8") as f:
+            old_index: dict[str, dict] = json.load(f)
+    except (FileNotFoundError, json.JSONDecodeError):
+        old_index = {}
+
+    index = {}
+    for config_path in consolidate.find_files(project_path, [config.CONFIG_FILENAME]):
+        if config_path.name != config.CONFIG_FILENAME:
+            continue
+        stat = config_path.stat()
+        stat_key = [stat.st_size, stat.st_mtime_ns]
+        record = old_index.get(str(config_path))
+        if record is None or record.get("stat") != stat_key:
+            record = {"stat": stat_key, "builds": _index_config(config_path)}
+        index[str(config_path)] = record
+
+    if index != old_index:
+        utils.write_if_changed(
+            index_path, json.dumps(index, indent=2, sort_keys=True).encode()
+        )
 
     entries = defaultdict(list)
-    for filepath in directory.glob("**/ato.yaml"):
-        cfg = config.get_project_config_from_path(filepath)
+    for record in index.values():
+        for build_name, build in record["builds"].items():
+            entries[build["entry"]].append(
+                LaidOutModule(
+                    name=build_name,
+                    entry=address.AddrStr(build["entry"]),
+                    layout_base=Path(build["layout_base"]),
+                )
+            )
+    return dict(entries)
+
+
+def _find_module_layouts() -> dict[str, list[LaidOutModule]]:
+    """
+    Return a dict of all the known entry points of dependencies in the project.
+    The dict maps the entry point's address to the builds of it, from which
+    their layout files can be found.
+
+    Configs can be added or changed between builds in the same process, like
+    the language server, so the index is checked against them every time.
+    """
+    return _index_module_layouts(config.get_project_context().project_path)
 
-        for build_name in cfg.builds:
-            ctx = config.BuildContext.from_config_name(cfg, build_name)
-            entries[ctx.entry].append(ctx)
 
-    return entries
+def _descendants_by_path(root: address.AddrStr) -> dict[str, address.AddrStr]:
+    """Return root's descendants, keyed by their instance path within root."""
+    root_section = address.get_instance_section(root)
+    prefix_len = len(root_section) + 1 if root_section else 0
+    return {
+        address.get_instance_section(descendant)[prefix_len:]: descendant
+        for descendant in all_descendants(root)
+        if descendant != root
+    }
 
 
 def generate_module_map(build_ctx: config.BuildContext) -> None:
@@ -62,8 +155,11 @@ def generate_module_map(build_ctx: config.BuildContext) -> None:
     module_map = {}
 
     laid_out_modules = _find_module_layouts()
+    component_table = components.get_component_table(build_ctx.entry)
+    # laid out entry -> child's path within it -> child's UUID in the layout
+    layout_uids: dict[address.AddrStr, dict[str, str]] = {}
     for module_instance in filter(match_modules, all_descendants(build_ctx.entry)):
-        module_super = find_matching_super(module_instance, list(laid_out_modules.keys()))
+        module_super = find_matching_super(module_instance, laid_out_modules)
         if not module_super:
             continue
 
@@ -71,7 +167,7 @@ def generate_module_map(build_ctx: config.BuildContext) -> None:
         if module_instance == build_ctx.entry:
             continue
 
-        # Get the build context for the laid out module
+        # Get the build of the laid out module
         module_super_ctxs = laid_out_modules[module_super]
         if len(module_super_ctxs) > 1:
             raise errors.AtoNotImplementedError(
@@ -83,20 +179,23 @@ def generate_module_map(build_ctx: config.BuildContext) -> None:
 
         # Build up a map of UUIDs of the children of the module
         # The keys are instance UUIDs and the values are the corresponding UUIDs in the layout
-        # FIXME: this currently relies on the `all_descendants` iterator returning the
-        # children in the same order. This is pretty fragile and should be fixed.
+        # Children are matched by their path within the module
+        if module_super_ctx.entry not in layout_uids:
+            layout_uids[module_super_ctx.entry] = {
+                path: generate_comp_uid(layout_addr)
+                for path, layout_addr in _descendants_by_path(
+                    module_super_ctx.entry
+                ).items()
+            }
+        module_layout_uids = layout_uids[module_super_ctx.entry]
+
         uuid_map = {}
-        for inst_addr, layout_addr in instance_methods.common_children(
-            module_instance, module_super_ctx.entry
-        ):
-            if not match_components(inst_addr):
+        for path, inst_addr in _descendants_by_path(module_instance).items():
+            if inst_addr not in component_table:
                 # Skip non-components
                 continue
-
-            # This should be enforced by the `common_children` function
-            assert address.get_name(inst_addr) == address.get_name(layout_addr)
-
-            uuid_map[generate_comp_uid(inst_addr)] = generate_comp_uid(layout_addr)
+            if path in module_layout_uids:
+                uuid_map[component_table[inst_addr].uid] = module_layout_uids[path]
 
         module_map[address.get_instance_section(module_instance)] = {
             "instance_path": module_instance,
@@ -3,11 +3,16 @@ This script largely controls the KiCAD CLI to generate
 gerbers/drill files/etc... required to make circuit boards
 """
 
+import hashlib
+import json
 import logging
 import re
+import shutil
 import subprocess
 import sys
+import threading
 import zipfile
+from concurrent.futures import ThreadPoolExecutor
 from functools import cache
 from os import PathLike
 from pathlib import Path
@@ -18,7 +23,7 @@ import git
 import semver
 
 import atopile.errors
-from atopile import config
+from atopile import config, utils
 
 log = logging.getLogger(__name__)
 
@@ -111,8 +116,17 @@ def _get_short_githash(project_path: Path) -> str:
 
 # FIXME: can't use a regular cached function here because build_ctx is mutable
 _ensure_modded_kicad_pcb_cache = {}
+# Targets using the modded board can be built at the same time
+_ensure_modded_kicad_pcb_lock = threading.Lock()
+
+
 def _ensure_modded_kicad_pcb(build_ctx: config.BuildContext) -> Path:
     """Ensure the KiCAD PCB file has been modified for manufacturing."""
+    with _ensure_modded_kicad_pcb_lock:
+        return _do_ensure_modded_kicad_pcb(build_ctx)
+
+
+def _do_ensure_modded_kicad_pcb(build_ctx: config.BuildContext) -> Path:
     # First, check if the build_ctx is in the cache
     if id(build_ctx) in _ensure_modded_kicad_pcb_cache:
         return _ensure_modded_kicad_pcb_cache[id(build_ctx)]
@@ -144,6 +158,30 @@ def _ensure_modded_kicad_pcb(build_ctx: config.BuildContext) -> Path:
     return modded_kicad_pcb
 
 
+# A fixed timestamp for the files in archives, so they're reproducible
+_ZIP_DATE_TIME = (1980, 1, 1, 0, 0, 0)
+
+
+def _zip_dir(src_dir: Path, zip_path: Path) -> None:
+    """Zip the files in src_dir, in a stable order, streaming each into the archive."""
+    with utils.atomic_open(zip_path, "wb") as f, zipfile.ZipFile(f, "w") as zip_file:
+        for file in sorted(p for p in src_dir.glob("*") if p.is_file()):
+            # Entries have always been named after the file's whole path
+            info = zipfile.ZipInfo.from_file(file)
+            info.date_time = _ZIP_DATE_TIME
+            info.external_attr = 0o644 << 16
+            with open(file, "rb") as src, zip_file.open(info, "w") as dst:
+                shutil.copyfileobj(src, dst)
+
+
+def _hash_file(path: Path) -> str:
+    digest = hashlib.sha256()
+    with open(path, "rb") as f:
+        for chunk in iter(lambda: f.read(1 << 20), b""):
+            digest.update(chunk)
+    return digest.hexdigest()
+
+
 def generate_manufacturing_data(build_ctx: config.BuildContext) -> None:
     """Generate manufacturing data for the project."""
     # If there's no layout, we can't generate manufacturing data
@@ -165,16 +203,35 @@ def generate_manufacturing_data(build_ctx: config.BuildContext) -> None:
     gerber_dir = build_ctx.output_base.with_name(
         f"{build_ctx.output_base.name}-gerbers-{short_githash}"
     )
+    zip_path = gerber_dir.with_suffix(".zip")
+    pos_path = build_ctx.output_base.with_suffix(".pos.csv")
+
+    kicad_cli = find_kicad_cli()
+
+    # The exports only depend on the board, so there's nothing to do if
+    # it's the same as it was the last time they were made
+    stamp_path = build_ctx.output_base.with_suffix(".mfg-data.json")
+    stamp = {
+        "board": _hash_file(modded_kicad_pcb),
+        "kicad_cli": str(get_cli_version(kicad_cli)),
+        "outputs": [str(zip_path), str(pos_path)],
+    }
+    try:
+        last_stamp = json.loads(stamp_path.read_text(encoding="utf-8"))
+    except (FileNotFoundError, json.JSONDecodeError):
+        last_stamp = None
+    if last_stamp == stamp and zip_path.exists() and pos_path.exists():
+        log.info("Manufacturing data is up to date")
+        return
+    stamp_path.unlink(missing_ok=True)
+
     gerber_dir.mkdir(exist_ok=True, parents=True)
     gerber_dir_str = str(gerber_dir)
     if not gerber_dir_str.endswith("/"):
         gerber_dir_str += "/"
 
-    kicad_cli = find_kicad_cli()
-
-    # Generate Gerbers
-    run(
-        [
+    exports = {
+        "gerbers": [
             kicad_cli,
             "pcb",
             "export",
@@ -182,10 +239,8 @@ def generate_manufacturing_data(build_ctx: config.BuildContext) -> None:
             "-o",
             gerber_dir_str,
             str(modded_kicad_pcb),
-        ]
-    )
-    run(
-        [
+        ],
+        "drill": [
             kicad_cli,
             "pcb",
             "export",
@@ -193,20 +248,8 @@ def generate_manufacturing_data(build_ctx: config.BuildContext) -> None:
             "-o",
             gerber_dir_str,
             str(modded_kicad_pcb),
-        ]
-    )
-
-    # Zip Gerbers
-    zip_path = gerber_dir.with_suffix(".zip")
-    with zipfile.ZipFile(zip_path, "w") as zip_file:
-        for file in gerber_dir.glob("*"):
-            zip_file.write(file)
-
-    # Position files need some massaging for JLCPCB
-    # We just need to replace the first row
-    pos_path = build_ctx.output_base.with_suffix(".pos.csv")
-    run(
-        [
+        ],
+        "pos": [
             kicad_cli,
             "pcb",
             "export",
@@ -219,12 +262,29 @@ def generate_manufacturing_data(build_ctx: config.BuildContext) -> None:
             "-o",
             str(pos_path),
             str(modded_kicad_pcb),
-        ]
-    )
+        ],
+    }
+
+    # The exports are independent, and each takes a while, so they're
+    # all run at once
+    with atopile.errors.ExceptionAccumulator() as err_cltr:
+        with ThreadPoolExecutor(max_workers=len(exports)) as executor:
+            futures = [executor.submit(run, args) for args in exports.values()]
+        for future in futures:
+            with err_cltr():
+                future.result()
+
+    # Zip Gerbers
+    _zip_dir(gerber_dir, zip_path)
+
+    # Position files need some massaging for JLCPCB
+    # We just need to replace the first row
     pos_contents = pos_path.read_text().splitlines()
     pos_contents[0] = "Designator,Value,Package,Mid X,Mid Y,Rotation,Layer"
     pos_path.write_text("\n".join(pos_contents))
 
+    stamp_path.write_text(json.dumps(stamp), encoding="utf-8")
+
 
 def generate_drc_report(build_ctx: config.BuildContext) -> None:
     """Generate manufacturing data for the project."""
@@ -0,0 +1,345 @@
+"""
+Check assertions statistically, by sampling the tolerances in the design.
+
+The assertion report checks each assertion at the extremes of its interval.
+Here instead, every toleranced value the assertions depend on is sampled and
+all the assertions are evaluated over all the samples at once, as numpy arrays,
+to find the yield of each.
+"""
+
+import functools
+import json
+import logging
+from typing import Optional
+
+import numpy as np
+import pint
+from attrs import define
+from rich.style import Style
+from rich.table import Table
+
+from atopile import address, assertions, config, errors, parse_utils, utils
+from atopile.expressions import RangedValue
+from atopile.front_end import Assertion
+
+log = logging.getLogger(__name__)
+
+light_row = Style(color="bright_black")
+dark_row = Style(color="white")
+
+_UNITLESS = pint.Unit("")
+
+# How many standard deviations a tolerance spans when sampling a gaussian
+TOLERANCE_SIGMAS = 3
+
+# The seed is fixed so the same design always yields the same report
+SEED = 0
+
+
+class SampledValue(RangedValue):
+    """
+    A batch of ranged values, represented as numpy arrays.
+
+    Samples have the same min and max, but literal ranges (eg. "within 1V to 2V")
+    still need to act like ranges, so both bounds are kept around.
+
+    This subclasses RangedValue so Python tries its reflected operators before
+    the RangedValue's own, eg. in "RangedValue + SampledValue".
+    """
+
+    def __init__(
+        self,
+        val_a: np.ndarray | float | int | pint.Quantity,
+        val_b: Optional[np.ndarray | float | int | pint.Quantity] = None,
+        unit: Optional[str | pint.Unit] = None,
+    ):
+        if val_b is None:
+            val_b = val_a
+
+        if unit:
+            self.unit = pint.Unit(unit)
+        elif isinstance(val_a, pint.Quantity):
+            self.unit = val_a.units
+        else:
+            self.unit = _UNITLESS
+
+        if isinstance(val_a, pint.Quantity):
+            val_a = val_a.to(self.unit).magnitude
+        if isinstance(val_b, pint.Quantity):
+            val_b = val_b.to(self.unit).magnitude
+
+        self.str_rep = None
+        self.min_val = np.minimum(val_a, val_b)
+        self.max_val = np.maximum(val_a, val_b)
+
+    @classmethod
+    def _make(
+        cls, min_val: np.ndarray, max_val: np.ndarray, unit: pint.Unit
+    ) -> "SampledValue":
+        """Make a SampledValue from bounds that are known to be ordered."""
+        self = cls.__new__(cls)
+        self.unit = unit
+        self.str_rep = None
+        self.min_val = min_val
+        self.max_val = max_val
+        return self
+
+    def __repr__(self) -> str:
+        return f"<{self.__class__.__name__} of {np.size(self.min_val)} '{self.unit}'>"
+
+    @classmethod
+    def _ensure(cls, thing) -> "SampledValue":
+        if isinstance(thing, SampledValue):
+            return thing
+        if isinstance(thing, RangedValue):
+            return cls._make(thing.min_val, thing.max_val, thing.unit)
+        return cls._make(thing, thing, _UNITLESS)
+
+    def _bounds_in(self, unit: pint.Unit) -> tuple[np.ndarray, np.ndarray]:
+        """Return the min and max magnitudes, converted to the given unit."""
+        if self.unit == unit:
+            return self.min_val, self.max_val
+        return (
+            pint.Quantity(self.min_val, self.unit).to(unit).magnitude,
+            pint.Quantity(self.max_val, self.unit).to(unit).magnitude,
+        )
+
+    def __add__(self, other) -> "SampledValue":
+        other_min, other_max = self._ensure(other)._bounds_in(self.unit)
+        return self._make(self.min_val + other_min, self.max_val + other_max, self.unit)
+
+    def __radd__(self, other) -> "SampledValue":
+        return self.__add__(other)
+
+    def __sub__(self, other) -> "SampledValue":
+        other_min, other_max = self._ensure(other)._bounds_in(self.unit)
+        return self._make(self.min_val - other_max, self.max_val - other_min, self.unit)
+
+    def __rsub__(self, other) -> "SampledValue":
+        return self._ensure(other).__sub__(self)
+
+    def __mul__(self, other) -> "SampledValue":
+        other = self._ensure(other)
+        products = (
+            self.min_val * other.min_val,
+            self.min_val * other.max_val,
+            self.max_val * other.min_val,
+            self.max_val * other.max_val,
+        )
+        return self._make(
+            functools.reduce(np.minimum, products),
+            functools.reduce(np.maximum, products),
+            self.unit * other.unit,
+        )
+
+    def __rmul__(self, other) -> "SampledValue":
+        return self.__mul__(other)
+
+    def __truediv__(self, other) -> "SampledValue":
+        other = self._ensure(other)
+        quotients = (
+            self.min_val / other.min_val,
+            self.min_val / other.max_val,
+            self.max_val / other.min_val,
+            self.max_val / other.max_val,
+        )
+        return self._make(
+            functools.reduce(np.minimum, quotients),
+            functools.reduce(np.maximum, quotients),
+            self.unit / other.unit,
+        )
+
+    def __rtruediv__(self, other) -> "SampledValue":
+        return self._ensure(other).__truediv__(self)
+
+    def __pow__(self, other) -> "SampledValue":
+        if isinstance(other, RangedValue):
+            other = self._ensure(other)
+            exponents = np.unique(np.append(other.min_val, other.max_val))
+            if not (other.unit.dimensionless and len(exponents) == 1):
+                raise ValueError("Exponent must be a constant valueless quantity")
+            other = exponents[0]
+
+        powers = (self.min_val**other, self.max_val**other)
+        return self._make(
+            np.minimum(*powers), np.maximum(*powers), self.unit**other
+        )
+
+    def __neg__(self) -> "SampledValue":
+        return self._make(-self.max_val, -self.min_val, self.unit)
+
+    def within(self, other) -> np.ndarray:
+        """Check, per sample, that this falls completely within another."""
+        other_min, other_max = self._ensure(other)._bounds_in(self.unit)
+        return (self.min_val >= other_min) & (other_max >= self.max_val)
+
+    def __lt__(self, other) -> np.ndarray:
+        other_min, _ = self._ensure(other)._bounds_in(self.unit)
+        return self.max_val < other_min
+
+    def __gt__(self, other) -> np.ndarray:
+        _, other_max = self._ensure(other)._bounds_in(self.unit)
+        return self.min_val > other_max
+
+    def __le__(self, other) -> np.ndarray:
+        other_min, _ = self._ensure(other)._bounds_in(self.unit)
+        return self.max_val <= other_min
+
+    def __ge__(self, other) -> np.ndarray:
+        _, other_max = self._ensure(other)._bounds_in(self.unit)
+        return self.min_val >= other_max
+
+
+def _sample_uniform(value: RangedValue, rng: np.random.Generator, n: int) -> np.ndarray:
+    return rng.uniform(value.min_val, value.max_val, n)
+
+
+def _sample_gaussian(value: RangedValue, rng: np.random.Generator, n: int) -> np.ndarray:
+    samples = rng.normal(value.nominal, value.tolerance / TOLERANCE_SIGMAS, n)
+    # Parts are screened to their tolerance, so don't sample beyond it
+    return np.clip(samples, value.min_val, value.max_val)
+
+
+_samplers = {
+    "uniform": _sample_uniform,
+    "gaussian": _sample_gaussian,
+}
+
+
+@define
+class AssertionSamples:
+    """Whether an assertion passed for each of the samples."""
+
+    instance_addr: address.AddrStr
+    assertion: Assertion
+    passes: np.ndarray
+
+    @property
+    def yield_(self) -> float:
+        """Return the fraction of the samples the assertion passed."""
+        return float(np.mean(self.passes))
+
+
+def simulate(
+    entry_addr: address.AddrStr,
+    samples_count: int,
+    distribution: str = "uniform",
+    seed: Optional[int] = SEED,
+) -> list[AssertionSamples]:
+    """
+    Evaluate every assertion under entry_addr over a batch of samples
+    of the toleranced values in the design.
+    """
+    try:
+        sample = _samplers[distribution]
+    except KeyError as ex:
+        raise config.AtoConfigError(
+            f"Unknown monte-carlo distribution '{distribution}'."
+            f" Options are: {', '.join(_samplers)}"
+        ) from ex
+
+    rng = np.random.default_rng(seed)
+
+    def _leaf(_, value: RangedValue) -> SampledValue:
+        samples = sample(value, rng, samples_count)
+        return SampledValue._make(samples, samples, value.unit)
+
+    context = assertions.SourceContext(_leaf)
+
+    results = []
+    with (
+        errors.ExceptionAccumulator() as exception_accumulator,
+        np.errstate(all="ignore"),
+    ):
+        for instance_addr, assertion in assertions.iter_source_assertions(entry_addr):
+            with exception_accumulator():
+                try:
+                    a = SampledValue._ensure(assertion.lhs(context))
+                    b = SampledValue._ensure(assertion.rhs(context))
+                    passes = assertions._do_op(a, assertion.operator, b)
+                except (KeyError, pint.DimensionalityError) as ex:
+                    raise assertions.ErrorComputingAssertion.from_ctx(
+                        assertion.src_ctx,
+                        "Exception computing assertion:"
+                        f" {ex.__class__.__name__} {str(ex)}",
+                    ) from ex
+
+                results.append(
+                    AssertionSamples(
+                        instance_addr,
+                        assertion,
+                        np.broadcast_to(passes, (samples_count,)),
+                    )
+                )
+
+    return results
+
+
+class YieldTable(Table):
+    def __init__(self, samples: int, distribution: str) -> None:
+        super().__init__(
+            show_header=True,
+            header_style="bold green",
+            title=f"Monte-Carlo Yield ({samples} {distribution} samples)",
+        )
+
+        self.add_column("Yield", justify="right")
+        self.add_column("Assertion")
+        self.add_column("Address")
+
+    def add(self, yield_: float, assertion_str: str, addr: str):
+        color = "green" if yield_ == 1 else "red"
+        super().add_row(
+            f"[{color}]{yield_:.3%}[/]",
+            assertion_str,
+            addr,
+            style=dark_row if len(self.rows) % 2 else light_row,
+        )
+
+
+def generate_monte_carlo_report(build_ctx: config.BuildContext):
+    """
+    Generate a report of the yield of each assertion made in the source code.
+    """
+    results = simulate(
+        build_ctx.entry,
+        build_ctx.monte_carlo_samples,
+        build_ctx.monte_carlo_distribution,
+    )
+
+    if not results:
+        log.info("No assertions to simulate")
+        return
+
+    table = YieldTable(build_ctx.monte_carlo_samples, build_ctx.monte_carlo_distribution)
+    report = []
+    for result in results:
+        assertion_str = parse_utils.reconstruct(result.assertion.src_ctx)
+        addr = address.get_instance_section(result.instance_addr) or "<root>"
+        table.add(result.yield_, assertion_str, addr)
+        report.append(
+            {
+                "address": result.instance_addr,
+                "assertion": assertion_str,
+                "yield": result.yield_,
+            }
+        )
+
+    # The samples are shared between assertions, so this is the fraction of
+    # boards expected to meet every assertion at once
+    overall_yield = float(np.mean(np.logical_and.reduce([r.passes for r in results])))
+    table.add(overall_yield, "[bold]All assertions[/]", "")
+    utils.rich_print(table)
+
+    with open(
+        build_ctx.output_base.with_suffix(".monte-carlo.json"), "w", encoding="utf-8"
+    ) as f:
+        json.dump(
+            {
+                "samples": build_ctx.monte_carlo_samples,
+                "distribution": build_ctx.monte_carlo_distribution,
+                "yield": overall_yield,
+                "assertions": report,
+            },
+            f,
+        )
@@ -1,171 +1,208 @@
-from pathlib import Path
-from typing import Optional
+"""
+Write KiCAD netlists, in KiCAD's S-expression format.
+
+Netlists are streamed out as they're worked out, rather than built up
+in memory first, which matters for big boards.
+
+eg.
+(export (version "E")
+  (design
+    (source "unknown")
+    (date "")
+    (tool "atopile"))
+  (components
+    (comp (ref "R1")
+      (value "10kΩ ±1%")
+      (footprint "lib:R0402")
+      (libsource (lib "lib") (part "C25744") (description "generics.ato:Resistor"))
+      (sheetpath (names "toy.ato:Toy::r1") (tstamps "b1d41e3b-ef4b-4472-9aa4-7860376ef0ce"))
+      (tstamps "b1d41e3b-ef4b-4472-9aa4-7860376ef0ce")))
+  (libparts
+    (libpart (lib "lib") (part "C25744")
+      (description "generics.ato:Resistor")
+      (docs "~")
+      (footprints
+        (fp "*"))
+      (pins
+        (pin (num "1") (name "1") (type "stereo"))
+        (pin (num "2") (name "2") (type "stereo")))))
+  (nets
+    (net (code "1") (name "vin")
+      (node (ref "R1") (pin "1") (pintype "stereo")))))
+"""
+
+import io
+from typing import NamedTuple, TextIO
 
-from jinja2 import Environment, FileSystemLoader, StrictUndefined
 from toolz import groupby
 
-from atopile import components, errors, nets, layout, config
+from atopile import components, errors, nets, config
 from atopile.address import AddrStr, get_name, get_relative_addr_str
+from atopile.components import ComponentAttributes
 from atopile.instance_methods import (
-    all_descendants,
     get_children,
     get_next_super,
     get_parent,
-    match_components,
     match_pins,
 )
-from atopile.kicad6_datamodel import (
-    KicadComponent,
-    KicadLibpart,
-    KicadNet,
-    KicadNetlist,
-    KicadNode,
-    KicadPin,
-    KicadSheetpath,
-)
 
 _get_mpn = errors.downgrade(
-    components.get_mpn, (components.MissingData, components.NoMatchingComponent)
+    lambda component: component.mpn,
+    (components.MissingData, components.NoMatchingComponent),
 )
 _get_value = errors.downgrade(
-    components.get_user_facing_value,
+    lambda component: component.value,
     (components.MissingData, components.NoMatchingComponent),
     default="?",
 )
 
+# TODO: something better for these
+_LIB = "lib"
+_DOCS = "~"
+_FOOTPRINTS = ["*"]
+_PINTYPE = "stereo"
+
+_HEADER = (
+    '(export (version "E")\n'
+    "  (design\n"
+    '    (source "unknown")\n'
+    '    (date "")\n'
+    '    (tool "atopile"))'
+)
 
-class NetlistBuilder:
-    """He builds netlists."""
 
-    def __init__(self):
-        """TODO:"""
-        self.netlist: Optional[KicadNetlist] = None
-        self._libparts: dict[tuple, KicadLibpart] = {}
-        self._components: dict[tuple, KicadComponent] = {}
-        self._nets: dict[str, KicadNet] = {}
+class _Libpart(NamedTuple):
+    """What KiCAD needs to know about each kind of component."""
 
-    def make_kicad_pin(self, pin_addr) -> KicadPin:
-        """Make a KiCAD pin object from a representative instance object."""
-        return KicadPin(name=get_name(pin_addr), type="stereo")
+    part: str
+    description: str
+    pins: list[str]
 
-    def make_libpart(self, comp_addr: AddrStr) -> KicadLibpart:
-        """Make a KiCAD libpart object from a representative instance object."""
-        model_pins = filter(match_pins, get_children(comp_addr))
-        pins = [self.make_kicad_pin(pin) for pin in model_pins]
-        # def _get_origin_of_instance(instance: Instance) -> Object:
-        #     return instance.origin
 
-        super_abs_addr = get_next_super(comp_addr).obj_def.address
-        super_addr = get_relative_addr_str(super_abs_addr, config.get_project_context().project_path)
-        constructed_libpart = KicadLibpart(
-            part=_get_mpn(comp_addr),
-            description=super_addr,
-            fields=[],
-            pins=pins,
-            # TODO: something better for these:
-            lib="lib",
-            docs="~",
-            footprints=["*"],
-        )
-        return constructed_libpart
-
-    def make_node(self, node_addr: AddrStr) -> KicadNode:
-        """Make a KiCAD node object from a representative instance object."""
-        parent = get_parent(node_addr)
-        node = KicadNode(
-            pin=get_name(node_addr),  # eg. 1
-            ref=components.get_designator(parent),  # eg. R1
-            pintype="stereo",
-        )
-        return node
-
-    def make_net(self, code, net_name, net_list) -> KicadNet:
-        """Make a KiCAD net object from a representative instance object."""
-        net = KicadNet(
-            code=code,
-            name=net_name,
-            nodes=[self.make_node(pin) for pin in filter(match_pins, net_list)],
+class NetlistWriter:
+    """He writes netlists."""
+
+    def __init__(self, f: TextIO):
+        self._write = f.write
+        self._table: dict[AddrStr, ComponentAttributes] = {}
+
+    def make_libpart(self, component: ComponentAttributes) -> _Libpart:
+        """Make a KiCAD libpart from a representative component."""
+        super_abs_addr = get_next_super(component.addr).obj_def.address
+        super_addr = get_relative_addr_str(
+            super_abs_addr, config.get_project_context().project_path
         )
-        return net
-
-    def make_component(
-        self, comp_addr: AddrStr, libsource: KicadLibpart
-    ) -> KicadComponent:
-        """Make a KiCAD component object from a representative instance object."""
-        tstamp = layout.generate_comp_uid(comp_addr)
-
-        # TODO: improve this
-        sheetpath = KicadSheetpath(  # That's not actually what we want. Will have to fix
-            names=comp_addr,  # TODO: going to have to strip the comp name from this
-            tstamps=tstamp,
+        pins = filter(match_pins, get_children(component.addr))
+        return _Libpart(
+            part=_get_mpn(component),
+            description=super_addr,
+            pins=[get_name(pin) for pin in pins],
         )
 
+    def write_component(
+        self, component: ComponentAttributes, libpart: _Libpart
+    ) -> None:
+        """Write a KiCAD component."""
         # add the lib: prefix if it's not there or there is a different prefix
         # This is used by kicad to reference which library the footprint is from
-        footprint_with_prefix = components.get_footprint(comp_addr)
-        if ":" not in footprint_with_prefix:
-            footprint_with_prefix = "lib:" + footprint_with_prefix
-
-        designator = components.get_designator(comp_addr)
-        constructed_component = KicadComponent(
-            ref=designator,
-            value=_get_value(comp_addr),
-            footprint= footprint_with_prefix,
-            libsource=libsource,
-            tstamp=tstamp,
-            fields=[],
-            sheetpath=sheetpath,
-            src_path=comp_addr,
+        footprint = component.footprint
+        if ":" not in footprint:
+            footprint = "lib:" + footprint
+
+        self._write(
+            f'\n    (comp (ref "{component.designator}")'
+            f'\n      (value "{_get_value(component)}")'
+            f'\n      (footprint "{footprint}")'
+            f'\n      (libsource (lib "{_LIB}") (part "{libpart.part}")'
+            f' (description "{libpart.description}"))'
+            # TODO: the names should be the module path, not the component's
+            f'\n      (sheetpath (names "{component.addr}")'
+            f' (tstamps "{component.uid}"))'
+            f'\n      (tstamps "{component.uid}"))'
         )
-        return constructed_component
 
-    def build(self, root) -> KicadNetlist:
-        """Build a netlist from an instance"""
-        self.netlist = KicadNetlist()
+    def write_libpart(self, libpart: _Libpart) -> None:
+        """Write a KiCAD libpart."""
+        self._write(f'\n    (libpart (lib "{_LIB}") (part "{libpart.part}")')
+        if libpart.description:
+            self._write(f'\n      (description "{libpart.description}")')
+        self._write(f'\n      (docs "{_DOCS}")')
+        self._write("\n      (footprints")
+        for footprint in _FOOTPRINTS:
+            self._write(f'\n        (fp "{footprint}")')
+        self._write(")")
+        if libpart.pins:
+            self._write("\n      (pins")
+            for pin in libpart.pins:
+                self._write(
+                    f'\n        (pin (num "{pin}") (name "{pin}") (type "{_PINTYPE}"))'
+                )
+        # NOTE: one of these closes the pins, so there's one too many
+        # without any, which we've always written
+        self._write("))")
+
+    def write_net(self, code: int, net_name: str, net_list: list[AddrStr]) -> None:
+        """Write a KiCAD net."""
+        self._write(f'\n    (net (code "{code}") (name "{net_name}")')
+        for pin in filter(match_pins, net_list):
+            self._write(
+                f'\n      (node (ref "{self._table[get_parent(pin)].designator}")'
+                f' (pin "{get_name(pin)}") (pintype "{_PINTYPE}"))'
+            )
+        self._write(")")
 
-        # We need to cast this to a list, otherwise we're trying to reuse a generator
-        all_components = list(filter(match_components, all_descendants(root)))
+    def write(self, root: AddrStr) -> None:
+        """Write the netlist of the design under root."""
+        self._table = components.get_component_table(root)
+        all_components = list(self._table.values())
 
         # first check that all the components have a footprint
         # otherwise we can't continue the netlist build
         for cltr, component in errors.iter_through_errors(all_components):
             with cltr():
-                components.get_footprint(component)
+                _ = component.footprint
+
+        self._write(_HEADER)
 
         # group the components by their footprint - because that seems
         # to be the only distinguishing feature KiCAD cares about
-        for footprint, group_components in groupby(
-            components.get_footprint, all_components
-        ).items():
-            libsource = self._libparts[footprint] = self.make_libpart(
-                group_components[0]
-            )
-
-            for component in group_components:
-                self._components[component] = self.make_component(component, libsource)
-
-        for code, (net_name, pin_signal_list) in enumerate(
-            nets.get_nets_by_name(root).items(), start=1
-        ):
-            self._nets[net_name] = self.make_net(code, net_name, pin_signal_list)
-
-        self.netlist.libparts = list(self._libparts.values())
-        self.netlist.components = list(self._components.values())
-        self.netlist.nets = list(self._nets.values())
-
-        return self.netlist
+        libparts = []
+        if all_components:
+            self._write("\n  (components")
+            for group_components in groupby(
+                lambda component: component.footprint, all_components
+            ).values():
+                libpart = self.make_libpart(group_components[0])
+                libparts.append(libpart)
+                for component in group_components:
+                    self.write_component(component, libpart)
+            self._write(")")
+
+        if libparts:
+            self._write("\n  (libparts")
+            for libpart in libparts:
+                self.write_libpart(libpart)
+            self._write(")")
+
+        nets_by_name = nets.get_nets_by_name(root)
+        if nets_by_name:
+            self._write("\n  (nets")
+            for code, (net_name, pin_signal_list) in enumerate(
+                nets_by_name.items(), start=1
+            ):
+                self.write_net(code, net_name, pin_signal_list)
+            self._write(")")
+
+        self._write(")\n")
+
+
+def write_netlist(root: AddrStr, f: TextIO) -> None:
+    """Write the netlist of the design under root to f."""
+    NetlistWriter(f).write(root)
 
 
 def get_netlist_as_str(root: AddrStr) -> str:
     """Return the netlist as a string."""
-    builder = NetlistBuilder()
-    netlist = builder.build(root)
-
-    env = Environment(
-        loader=FileSystemLoader(Path(__file__).parent), undefined=StrictUndefined
-    )
-
-    # Create the complete netlist
-    template = env.get_template("kicad6.j2")
-    netlist_str = template.render(nl=netlist)
-    return netlist_str
+    f = io.StringIO()
+    write_netlist(root, f)
+    return f.getvalue()
@@ -0,0 +1,104 @@
+"""
+Values worked out for a build, layered over the elaborated model.
+
+Elaborating a design only depends on its source, so the model it produces
+is shared by every build of the design, and isn't changed once it's built.
+Simplifying expressions and solving assertions work out values particular
+to a build. Those are stacked on the model's assignments in the build's
+overlay, which is what everything reading the model through
+`instance_methods` sees.
+
+Which overlay's active is global to the process, rather than to a thread,
+so the targets a build runs on threads all see the same values. Builds
+which run at the same time do so in separate processes.
+"""
+
+import functools
+from contextlib import contextmanager
+from typing import Any, Callable, Hashable, Iterator, Mapping, Sequence, TypeVar
+
+from attrs import define, field
+
+from atopile.front_end import Assignment, Instance
+
+
+@define(eq=False)
+class Overlay:
+    """The values worked out for a build."""
+
+    # id(instance) -> (instance, name -> assignments, most recent first)
+    # The instance is kept alongside, so its id isn't reused while it's here
+    _layers: dict[int, tuple[Instance, dict[str, list[Assignment]]]] = field(
+        factory=dict
+    )
+
+    # Anything else derived from the model's values, particular to this overlay
+    derived: dict[Hashable, Any] = field(factory=dict)
+
+    def assign(self, instance: Instance, assignment: Assignment) -> None:
+        """Stack an assignment on top of the instance's."""
+        _, layer = self._layers.setdefault(id(instance), (instance, {}))
+        layer.setdefault(assignment.name, []).insert(0, assignment)
+
+    def get_assignments(self, instance: Instance, name: str) -> Sequence[Assignment]:
+        """Return the assignments to an instance's attribute, most recent first."""
+        layer = self._layers.get(id(instance))
+        # Nearly everything's read without anything stacked on it, so it's
+        # returned as it is, rather than copied
+        if layer is None or name not in layer[1]:
+            return instance.assignments.get(name, [])
+        return layer[1][name] + list(instance.assignments.get(name, ()))
+
+    def get_all_assignments(
+        self, instance: Instance
+    ) -> Mapping[str, Sequence[Assignment]]:
+        """Return the assignments to all an instance's attributes."""
+        if id(instance) not in self._layers:
+            return instance.assignments
+        return {name: self.get_assignments(instance, name) for name in instance.assignments}
+
+
+_active = Overlay()
+
+
+def get_active() -> Overlay:
+    """Return the overlay everything's reading the model through."""
+    return _active
+
+
+@contextmanager
+def activate(overlay: Overlay) -> Iterator[Overlay]:
+    """Read and write the model through overlay, until the context exits."""
+    global _active
+    previous = _active
+    _active = overlay
+    try:
+        yield overlay
+    finally:
+        _active = previous
+
+
+T = TypeVar("T")
+
+
+def cache(func: Callable[..., T]) -> Callable[..., T]:
+    """
+    Like functools.cache, but for functions of the model's values, which
+    are cached separately for each overlay. The results are kept in the
+    overlay's derived values, so they're forgotten along with it.
+    """
+
+    @functools.wraps(func)
+    def wrapper(*args, **kwargs) -> T:
+        results = _active.derived.setdefault(wrapper, {})
+        key = (args, tuple(sorted(kwargs.items())))
+        if key not in results:
+            results[key] = func(*args, **kwargs)
+        return results[key]
+
+    def cache_clear() -> None:
+        """Forget the results worked out under the active overlay."""
+        _active.derived.pop(wrapper, None)
+
+    wrapper.cache_clear = cache_clear
+    return wrapper
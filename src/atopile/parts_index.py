@@ -0,0 +1,209 @@
+"""
+A local, offline index of parts to select generic components from.
+
+The index is loaded from a snapshot file, which is JSON (optionally
+gzipped) in the form:
+
+    {
+        "components": [
+            {
+                "lcsc_id": "C25744",
+                "type": "resistor",
+                "package": "0402",
+                "value": {"unit": "kiloohm", "min_val": 9.9, "max_val": 10.1},
+                "basic": true,
+                "price": 0.0005,
+                "stock": 1000000,
+                ... anything else the components service returns for a part
+            },
+            ...
+        ]
+    }
+
+Parts are matched to specs from `RangedValue.to_dict()` the same way the
+components service matches them; see `PartsIndex.find`.
+"""
+
+import bisect
+import gzip
+import json
+import logging
+from functools import cache
+from pathlib import Path
+from typing import Any, Iterable, Optional
+
+import pint
+
+from atopile import errors
+
+log = logging.getLogger(__name__)
+
+
+# The attribute parts are sorted by within the index, to narrow searches
+INDEXED_ATTR = "value"
+
+# Spec attributes which identify the part's kind, rather than constrain it
+_IGNORED_ATTRS = {"mpn", "footprint", "designator_prefix", "designator"}
+
+
+class PartsIndexError(errors.AtoError):
+    """
+    Raised when a parts index can't be loaded.
+    """
+
+    title = "Invalid parts index"
+
+
+@cache
+def _to_base(unit: str) -> tuple[float, str]:
+    """Return the factor to convert unit to base units with, and its dimensionality."""
+    qty = pint.Quantity(1, unit).to_base_units()
+    return qty.magnitude, str(qty.units)
+
+
+def _is_ranged(thing: Any) -> bool:
+    return isinstance(thing, dict) and {"unit", "min_val", "max_val"} <= thing.keys()
+
+
+def _base_range(ranged: dict) -> tuple[float, float, str]:
+    """Return the range of a ranged attribute, in base units."""
+    factor, unit = _to_base(ranged["unit"])
+    return ranged["min_val"] * factor, ranged["max_val"] * factor, unit
+
+
+def _slack(low: float, high: float) -> float:
+    """Return how far outside a range to allow for rounding in converting units."""
+    return 1e-9 * max(abs(low), abs(high))
+
+
+def _preference(part: dict) -> tuple:
+    """Sort key putting the parts we'd rather use first."""
+    return (
+        not part.get("basic", False),
+        part.get("price", float("inf")),
+        -part.get("stock", 0),
+        part["lcsc_id"],
+    )
+
+
+class _Bucket:
+    """Parts of one type and package."""
+
+    def __init__(self) -> None:
+        self.parts: list[dict] = []
+        # Parts with values, sorted by the centre of their value
+        self.valued: list[dict] = []
+        self.centres: list[float] = []
+
+
+class PartsIndex:
+    """
+    Parts, indexed by type and package, and sorted by value within those.
+    """
+
+    def __init__(self, parts: Iterable[dict]) -> None:
+        # (type, package) -> bucket, where the bucket for a package of
+        # None holds all the parts of the type
+        self._buckets: dict[tuple[str, Optional[str]], _Bucket] = {}
+        valued: dict[tuple[str, Optional[str]], list[tuple[float, dict]]] = {}
+        self._count = 0
+        for part in parts:
+            self._count += 1
+            try:
+                kinds = [(part["type"], part.get("package")), (part["type"], None)]
+                for kind in kinds:
+                    self._buckets.setdefault(kind, _Bucket()).parts.append(part)
+
+                if INDEXED_ATTR in part:
+                    low, high, _ = _base_range(part[INDEXED_ATTR])
+                    for kind in kinds:
+                        valued.setdefault(kind, []).append(((low + high) / 2, part))
+            except (KeyError, TypeError, pint.errors.PintError) as ex:
+                raise PartsIndexError(f"Invalid part {part.get('lcsc_id')}: {ex}") from ex
+
+        for kind, entries in valued.items():
+            entries.sort(key=lambda e: e[0])
+            bucket = self._buckets[kind]
+            bucket.centres = [centre for centre, _ in entries]
+            bucket.valued = [part for _, part in entries]
+
+    def __len__(self) -> int:
+        return self._count
+
+    @classmethod
+    def from_file(cls, path: Path) -> "PartsIndex":
+        """Load an index from a snapshot file."""
+        opener = gzip.open if path.suffix == ".gz" else open
+        try:
+            with opener(path, "rt", encoding="utf-8") as f:
+                snapshot = json.load(f)
+            return cls(snapshot["components"])
+        except (OSError, json.JSONDecodeError, KeyError, TypeError) as ex:
+            raise PartsIndexError(f"Couldn't load parts index {path}: {ex}") from ex
+
+    def _candidates(self, spec: dict[str, Any]) -> list[dict]:
+        bucket = self._buckets.get((spec.get("type"), spec.get("package")))
+        if bucket is None:
+            return []
+
+        ranged = spec.get(INDEXED_ATTR)
+        if not _is_ranged(ranged):
+            return bucket.parts
+
+        # A part within the spec's range has its centre within it too
+        try:
+            low, high, _ = _base_range(ranged)
+        except pint.errors.PintError:
+            return []
+        slack = _slack(low, high)
+        return bucket.valued[
+            bisect.bisect_left(bucket.centres, low - slack):
+            bisect.bisect_right(bucket.centres, high + slack)
+        ]
+
+    @staticmethod
+    def matches(part: dict, spec: dict[str, Any]) -> bool:
+        """
+        Return whether a part satisfies a spec.
+
+        Ranged attributes of the part must lie entirely within the spec's
+        range, and all other attributes must be equal.
+        """
+        for key, wanted in spec.items():
+            if key in _IGNORED_ATTRS:
+                continue
+
+            if key not in part:
+                return False
+            actual = part[key]
+
+            if _is_ranged(wanted):
+                if not _is_ranged(actual):
+                    return False
+                try:
+                    w_low, w_high, w_unit = _base_range(wanted)
+                    a_low, a_high, a_unit = _base_range(actual)
+                except pint.errors.PintError:
+                    return False
+                slack = _slack(w_low, w_high)
+                if w_unit != a_unit or a_low < w_low - slack or a_high > w_high + slack:
+                    return False
+            elif actual != wanted:
+                return False
+
+        return True
+
+    def find(self, spec: dict[str, Any]) -> Optional[dict]:
+        """Return the best part satisfying spec, if there is one."""
+        matches = [part for part in self._candidates(spec) if self.matches(part, spec)]
+        if not matches:
+            return None
+        return min(matches, key=_preference)
+
+
+@cache
+def load(path: Path) -> PartsIndex:
+    """Return the parts index in the snapshot at path."""
+    index = PartsIndex.from_file(path)
+    log.info("Loaded %s parts from %s", len(index), path)
+    return index
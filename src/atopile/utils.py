@@ -1,7 +1,14 @@
 import os
 import shutil
 import stat
+import sys
+import tempfile
+import threading
+from contextlib import contextmanager
 from pathlib import Path
+from typing import IO, Iterator
+
+import rich
 
 
 def robustly_rm_dir(path: Path) -> None:
@@ -12,3 +19,109 @@ def robustly_rm_dir(path: Path) -> None:
         func(path)
 
     shutil.rmtree(path, onerror=remove_readonly)
+
+
+def write_if_changed(path: Path, content: bytes) -> bool:
+    """
+    Write content to path, unless it's already there, so its mtime only
+    changes when its content does. Returns whether the file was written.
+    """
+    try:
+        if path.read_bytes() == content:
+            return False
+    except FileNotFoundError:
+        pass
+
+    with atomic_open(path, "wb") as f:
+        f.write(content)
+    return True
+
+
+def _get_umask() -> int:
+    # There's no way to read the umask without setting it
+    umask = os.umask(0o022)
+    os.umask(umask)
+    return umask
+
+
+# Read once, while there's only the one thread to see it change
+_UMASK = _get_umask()
+
+
+def _new_file_mode(path: Path) -> int:
+    """Return the mode of the file at path, or else what a new one would get."""
+    try:
+        return stat.S_IMODE(path.stat().st_mode)
+    except FileNotFoundError:
+        return 0o666 & ~_UMASK
+
+
+@contextmanager
+def atomic_open(path: Path, mode: str = "w", **kwargs) -> Iterator[IO]:
+    """
+    Open a file to write to path, which is only moved into place once it's
+    been completely written, so nothing ever sees half a file.
+
+    The file keeps the mode of the one it replaces, or else gets the mode
+    the umask gives new files.
+    """
+    path.parent.mkdir(parents=True, exist_ok=True)
+    fd, tmp_path = tempfile.mkstemp(dir=path.parent, prefix=f".{path.name}.")
+    try:
+        with os.fdopen(fd, mode, **kwargs) as f:
+            # Temporary files are only readable by their owner, unlike what
+            # they're standing in for
+            os.chmod(tmp_path, _new_file_mode(path))
+            yield f
+        os.replace(tmp_path, path)
+    except BaseException:
+        os.unlink(tmp_path)
+        raise
+
+
+@contextmanager
+def file_lock(path: Path) -> Iterator[None]:
+    """
+    Hold an exclusive lock on the file at path for as long as the context's
+    open, which other processes - and other threads - taking it wait for.
+
+    The file's created if it's not there, and left behind afterwards.
+    """
+    path.parent.mkdir(parents=True, exist_ok=True)
+    with open(path, "a+b") as f:
+        if sys.platform == "win32":
+            import msvcrt  # pylint: disable=import-outside-toplevel,import-error
+
+            # Locks are on bytes from where the file is up to
+            f.seek(0)
+            while True:
+                try:
+                    # Waits up to 10s, before raising
+                    msvcrt.locking(f.fileno(), msvcrt.LK_LOCK, 1)
+                    break
+                except OSError:
+                    continue
+            try:
+                yield
+            finally:
+                f.seek(0)
+                msvcrt.locking(f.fileno(), msvcrt.LK_UNLCK, 1)
+        else:
+            import fcntl  # pylint: disable=import-outside-toplevel
+
+            fcntl.flock(f.fileno(), fcntl.LOCK_EX)
+            try:
+                yield
+            finally:
+                fcntl.flock(f.fileno(), fcntl.LOCK_UN)
+
+
+# Targets are built at the same time, on threads, so what they print to
+# the console is printed while holding this, to keep it from interleaving
+print_lock = threading.RLock()
+
+
+def rich_print(*objects) -> None:
+    """Print objects, like rich.print, in one piece."""
+    with print_lock:
+        rich.print(*objects)
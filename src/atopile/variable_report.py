@@ -4,11 +4,18 @@ Generate a report based on assertions made in the source code.
 
 import logging
 
-import rich
 from rich.style import Style
 from rich.table import Table
 
-from atopile import address, config, expressions, instance_methods, parse_utils
+from atopile import (
+    address,
+    config,
+    expressions,
+    instance_methods,
+    overlay,
+    parse_utils,
+    utils,
+)
 
 log = logging.getLogger(__name__)
 
@@ -47,7 +54,9 @@ def generate(build_ctx: config.BuildContext):
     report = VariableReport()
     for addr in instance_methods.all_descendants(build_ctx.entry):
         instance = instance_methods.get_instance(addr)
-        for key, assignments in instance.assignments.items():
+        for key, assignments in overlay.get_active().get_all_assignments(
+            instance
+        ).items():
             # Expressions always have always at least two assignments
             if len(assignments) < 2:
                 continue
@@ -75,4 +84,4 @@ def generate(build_ctx: config.BuildContext):
 
             report.add(k_addr, value, comment)
 
-    rich.print(report)
+    utils.rich_print(report)
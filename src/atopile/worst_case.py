@@ -0,0 +1,514 @@
+"""
+Find the worst-case corner of each assertion made in the source code.
+
+The assertion report evaluates each side of an assertion with interval
+arithmetic, which is pessimistic wherever a value appears more than once in
+an expression (eg. a divider's ratio, r1 / (r1 + r2)) and doesn't say which
+of the toleranced values are to blame when an assertion fails.
+
+Here, each assertion is reduced to a margin, which is positive where it fails,
+and the corner of the toleranced values maximising it is searched for.
+Alongside the margin, its partial derivatives with respect to each of the
+toleranced values are bounded over the box being searched, so values the
+margin is monotonic in are fixed to the appropriate extreme straight away.
+Corners are only enumerated for the values left over, and sub-boxes are
+skipped entirely where the margin's bound can't beat the worst corner so far.
+"""
+
+import json
+import logging
+import math
+import operator
+import textwrap
+from typing import Callable
+
+import pint
+from attrs import define, field
+from rich.style import Style
+from rich.table import Table
+
+from atopile import address, assertions, config, errors, parse_utils, utils
+from atopile.expressions import RangedValue
+from atopile.front_end import Assertion
+
+log = logging.getLogger(__name__)
+
+light_row = Style(color="bright_black")
+dark_row = Style(color="white")
+
+_UNITLESS = pint.Unit("")
+
+# Upper limit on the evaluations spent searching for a single assertion's
+# worst-case corner, which is only approached by highly non-monotonic ones
+MAX_EVALUATIONS = 2**16
+
+Interval = tuple[float, float]
+_ZERO: Interval = (0.0, 0.0)
+_ONE: Interval = (1.0, 1.0)
+
+
+def _add(a: Interval, b: Interval) -> Interval:
+    return a[0] + b[0], a[1] + b[1]
+
+
+def _sub(a: Interval, b: Interval) -> Interval:
+    return a[0] - b[1], a[1] - b[0]
+
+
+def _mul(a: Interval, b: Interval) -> Interval:
+    # By convention, 0 * inf is 0 in interval arithmetic
+    products = [x * y if x and y else 0.0 for x in a for y in b]
+    return min(products), max(products)
+
+
+def _div(a: Interval, b: Interval) -> Interval:
+    if b[0] <= 0 <= b[1]:
+        return -math.inf, math.inf
+    return _mul(a, (1 / b[1], 1 / b[0]))
+
+
+def _pow(a: Interval, exponent: float) -> Interval:
+    lo, hi = a
+    if exponent < 0 and lo <= 0 <= hi:
+        return -math.inf, math.inf
+    if lo < 0 and not float(exponent).is_integer():
+        raise ValueError("Can't raise a negative value to a fractional power")
+    powers = [lo**exponent, hi**exponent]
+    if lo < 0 < hi:
+        # Even powers bottom out in the middle
+        powers.append(0.0)
+    return min(powers), max(powers)
+
+
+class _Dual(RangedValue):
+    """
+    A value, as a function of the toleranced values in a box.
+
+    min_val and max_val bound the value over the box, and grads bound its partial
+    derivative with respect to each of the toleranced values which aren't yet
+    fixed. Values missing from grads don't affect it.
+
+    Like monte_carlo.SampledValue, this subclasses RangedValue so Python tries
+    its reflected operators before the RangedValue's own.
+    """
+
+    grads: dict[address.AddrStr, Interval]
+
+    @classmethod
+    def _make(
+        cls,
+        value: Interval,
+        unit: pint.Unit,
+        grads: dict[address.AddrStr, Interval],
+    ) -> "_Dual":
+        self = cls.__new__(cls)
+        self.min_val, self.max_val = value
+        self.unit = unit
+        self.str_rep = None
+        self.grads = grads
+        return self
+
+    @classmethod
+    def _ensure(cls, thing) -> "_Dual":
+        if isinstance(thing, _Dual):
+            return thing
+        if isinstance(thing, RangedValue):
+            return cls._make((thing.min_val, thing.max_val), thing.unit, {})
+        return cls._make((thing, thing), _UNITLESS, {})
+
+    @classmethod
+    def leaf(cls, addr: address.AddrStr, bounds: Interval, unit: pint.Unit) -> "_Dual":
+        """Make a toleranced value, which is free to vary unless its bounds meet."""
+        return cls._make(bounds, unit, {addr: _ONE} if bounds[0] < bounds[1] else {})
+
+    def __repr__(self) -> str:
+        return (
+            f"<{self.__class__.__name__} {self.min_val} to {self.max_val} '{self.unit}'"
+            f" of {len(self.grads)} values>"
+        )
+
+    @property
+    def _value(self) -> Interval:
+        return self.min_val, self.max_val
+
+    def _in(self, unit: pint.Unit) -> "_Dual":
+        """Return the same value, converted to the given unit."""
+        if self.unit == unit:
+            return self
+        factor = (pint.Quantity(1, self.unit).to(unit).magnitude,) * 2
+        return self._make(
+            _mul(self._value, factor),
+            unit,
+            {k: _mul(g, factor) for k, g in self.grads.items()},
+        )
+
+    def _combine_grads(
+        self, other: "_Dual", func: Callable[[Interval, Interval], Interval]
+    ) -> dict[address.AddrStr, Interval]:
+        return {
+            k: func(self.grads.get(k, _ZERO), other.grads.get(k, _ZERO))
+            for k in self.grads.keys() | other.grads.keys()
+        }
+
+    def __add__(self, other) -> "_Dual":
+        other = self._ensure(other)._in(self.unit)
+        return self._make(
+            _add(self._value, other._value),
+            self.unit,
+            self._combine_grads(other, _add),
+        )
+
+    def __radd__(self, other) -> "_Dual":
+        return self.__add__(other)
+
+    def __sub__(self, other) -> "_Dual":
+        other = self._ensure(other)._in(self.unit)
+        return self._make(
+            _sub(self._value, other._value),
+            self.unit,
+            self._combine_grads(other, _sub),
+        )
+
+    def __rsub__(self, other) -> "_Dual":
+        return self._ensure(other).__sub__(self)
+
+    def __mul__(self, other) -> "_Dual":
+        other = self._ensure(other)
+        # (ab)' = a'b + ab'
+        return self._make(
+            _mul(self._value, other._value),
+            self.unit * other.unit,
+            self._combine_grads(
+                other,
+                lambda ga, gb: _add(_mul(ga, other._value), _mul(self._value, gb)),
+            ),
+        )
+
+    def __rmul__(self, other) -> "_Dual":
+        return self.__mul__(other)
+
+    def __truediv__(self, other) -> "_Dual":
+        other = self._ensure(other)
+        quotient = _div(self._value, other._value)
+        # (a/b)' = (a' - (a/b)b') / b
+        return self._make(
+            quotient,
+            self.unit / other.unit,
+            self._combine_grads(
+                other,
+                lambda ga, gb: _div(_sub(ga, _mul(quotient, gb)), other._value),
+            ),
+        )
+
+    def __rtruediv__(self, other) -> "_Dual":
+        return self._ensure(other).__truediv__(self)
+
+    def __pow__(self, other) -> "_Dual":
+        if isinstance(other, RangedValue):
+            if not (
+                other.unit.dimensionless
+                and other.min_val == other.max_val
+                and not getattr(other, "grads", None)
+            ):
+                raise ValueError("Exponent must be a constant valueless quantity")
+            other = other.min_val
+
+        # (a^n)' = n a^(n-1) a'
+        slope = _mul(_pow(self._value, other - 1), (other, other))
+        return self._make(
+            _pow(self._value, other),
+            self.unit**other,
+            {k: _mul(slope, g) for k, g in self.grads.items()},
+        )
+
+    def __neg__(self) -> "_Dual":
+        return self._make(
+            (-self.max_val, -self.min_val),
+            self.unit,
+            {k: (-g[1], -g[0]) for k, g in self.grads.items()},
+        )
+
+    def min(self) -> "_Dual":
+        """
+        Where the value depends on values still free to vary, its minimum
+        depends on the rest of the corner, so this is left to the search.
+        What's left is the spread of the ranges written in the source, of
+        which this is the bottom.
+        """
+        if self.grads:
+            return self
+        return self._make((self.min_val, self.min_val), self.unit, {})
+
+    def max(self) -> "_Dual":
+        """
+        Where the value depends on values still free to vary, its maximum
+        depends on the rest of the corner, so this is left to the search.
+        What's left is the spread of the ranges written in the source, of
+        which this is the top.
+        """
+        if self.grads:
+            return self
+        return self._make((self.max_val, self.max_val), self.unit, {})
+
+
+# Each comparison is reduced to one or more margins, which are positive where it
+# fails. Each margin's given as a pair of functions of the lhs and rhs; the first
+# bounds it over a box and the second gives its exact value at a corner.
+_Margin = tuple[Callable[[_Dual, _Dual], _Dual], Callable[[_Dual, _Dual], float]]
+
+_margins: dict[str, list[_Margin]] = {
+    "<": [(operator.sub, lambda a, b: a.max_val - b.min_val)],
+    "<=": [(operator.sub, lambda a, b: a.max_val - b.min_val)],
+    ">": [(lambda a, b: b - a, lambda a, b: b.max_val - a.min_val)],
+    ">=": [(lambda a, b: b - a, lambda a, b: b.max_val - a.min_val)],
+    "within": [
+        (lambda a, b: b - a, lambda a, b: b.min_val - a.min_val),
+        (operator.sub, lambda a, b: a.max_val - b.max_val),
+    ],
+}
+
+
+class WorstCaseSearchExhausted(assertions.AssertionException):
+    """
+    Raised when the search for an assertion's worst-case
+    corner runs out of evaluations.
+    """
+
+
+@define
+class WorstCase:
+    """The worst-case corner of an assertion."""
+
+    instance_addr: address.AddrStr
+    assertion: Assertion
+    passes: bool
+    numeric: str
+    # Which extreme each of the toleranced values sits at, and its value there
+    corner: dict[address.AddrStr, tuple[str, RangedValue]]
+    evaluations: int
+
+
+@define
+class _Search:
+    """Search for the corner of the box with the greatest margin."""
+
+    assertion: Assertion
+    # The full range of, and unit of, each of the toleranced values found so far
+    bounds: dict[address.AddrStr, Interval] = field(factory=dict)
+    units: dict[address.AddrStr, pint.Unit] = field(factory=dict)
+    evaluations: int = 0
+
+    def evaluate(self, box: dict[address.AddrStr, Interval]) -> tuple[_Dual, _Dual]:
+        """Evaluate both sides of the assertion over the box."""
+        self.evaluations += 1
+        if self.evaluations > MAX_EVALUATIONS:
+            raise WorstCaseSearchExhausted.from_ctx(
+                self.assertion.src_ctx,
+                f"Gave up searching for the worst-case corner after {MAX_EVALUATIONS}"
+                " evaluations. This assertion depends on too many values it isn't"
+                " monotonic in.",
+            )
+
+        def _leaf(addr: address.AddrStr, value: RangedValue) -> _Dual:
+            if addr not in self.bounds:
+                self.bounds[addr] = (value.min_val, value.max_val)
+                self.units[addr] = value.unit
+            return _Dual.leaf(addr, box.get(addr, self.bounds[addr]), value.unit)
+
+        context = assertions.SourceContext(_leaf)
+        a = _Dual._ensure(self.assertion.lhs(context))
+        b = _Dual._ensure(self.assertion.rhs(context))._in(a.unit)
+        return a, b
+
+    def run(self, margin: _Margin) -> tuple[float, dict[address.AddrStr, Interval]]:
+        """Return the greatest margin and the corner it's at."""
+        bound_margin, corner_margin = margin
+        worst_margin = -math.inf
+        worst_corner = {}
+
+        stack = [{}]
+        while stack:
+            box = stack.pop()
+
+            # Fix the values the margin's monotonic in. Doing so tightens the
+            # bounds on the rest, so repeat until there's nothing left to fix
+            while True:
+                a, b = self.evaluate(box)
+                bound = bound_margin(a, b)
+                if bound.max_val <= worst_margin:
+                    break
+
+                fixed = False
+                for addr, (grad_lo, grad_hi) in bound.grads.items():
+                    lo, hi = box.get(addr, self.bounds[addr])
+                    if grad_lo >= 0:
+                        box[addr] = (hi, hi)
+                        fixed = True
+                    elif grad_hi <= 0:
+                        box[addr] = (lo, lo)
+                        fixed = True
+                if not fixed:
+                    break
+
+            if bound.max_val <= worst_margin:
+                # Nothing in here can be worse than what we've already found
+                continue
+
+            if not bound.grads:
+                # Everything's fixed, so we're at a corner
+                value = corner_margin(a, b)
+                if value > worst_margin:
+                    worst_margin = value
+                    worst_corner = {**self.bounds, **box}
+                continue
+
+            # Enumerate both extremes of the least predictable value
+            addr = max(bound.grads, key=lambda k: bound.grads[k][1] - bound.grads[k][0])
+            lo, hi = box.get(addr, self.bounds[addr])
+            stack.append({**box, addr: (lo, lo)})
+            stack.append({**box, addr: (hi, hi)})
+
+        return worst_margin, worst_corner
+
+
+def find_worst_case(instance_addr: address.AddrStr, assertion: Assertion) -> WorstCase:
+    """
+    Find the corner of the toleranced values an assertion
+    depends on where it comes closest to failing.
+    """
+    if assertion.operator not in _margins:
+        raise ValueError(f"Unrecognized operator: {assertion.operator}")
+
+    search = _Search(assertion)
+    try:
+        _, corner = max(
+            (search.run(margin) for margin in _margins[assertion.operator]),
+            key=lambda result: result[0],
+        )
+
+        # Check the assertion at the corner, just like the assertion report would
+        context = assertions.SourceContext(
+            lambda addr, value: RangedValue(corner[addr][0], corner[addr][0], value.unit)
+        )
+        a = assertion.lhs(context)
+        b = assertion.rhs(context)
+        passes = assertions._do_op(a, assertion.operator, b)
+    except (KeyError, ValueError, pint.DimensionalityError) as ex:
+        raise assertions.ErrorComputingAssertion.from_ctx(
+            assertion.src_ctx,
+            f"Exception computing assertion: {ex.__class__.__name__} {str(ex)}",
+        ) from ex
+
+    return WorstCase(
+        instance_addr,
+        assertion,
+        passes,
+        (
+            a.pretty_str(format_="bound")
+            + " " + assertion.operator + " "
+            + b.pretty_str(format_="bound")
+        ),
+        {
+            addr: (
+                "max" if value == search.bounds[addr][1] else "min",
+                RangedValue(value, value, search.units[addr]),
+            )
+            for addr, (value, _) in corner.items()
+        },
+        search.evaluations,
+    )
+
+
+class WorstCaseTable(Table):
+    def __init__(self) -> None:
+        super().__init__(
+            show_header=True, header_style="bold green", title="Worst-Case Corners"
+        )
+
+        self.add_column("Status")
+        self.add_column("Assertion")
+        self.add_column("Worst-Case")
+        self.add_column("Critical Corner")
+
+    def add_row(
+        self,
+        status: str,
+        assertion_str: str,
+        numeric: str,
+        corner: str,
+    ):
+        super().add_row(
+            status,
+            assertion_str,
+            numeric,
+            corner,
+            style=dark_row if len(self.rows) % 2 else light_row,
+        )
+
+
+def _format_corner(corner: dict[address.AddrStr, tuple[str, RangedValue]]) -> str:
+    return "\n".join(
+        f"{address.get_instance_section(addr)} = {value.pretty_str()} ({extreme})"
+        for addr, (extreme, value) in corner.items()
+    )
+
+
+def generate_worst_case_report(build_ctx: config.BuildContext):
+    """
+    Generate a report of the worst-case corner of each assertion made in the source code.
+    """
+    table = WorstCaseTable()
+    report = []
+    with errors.ExceptionAccumulator() as exception_accumulator:
+        for instance_addr, assertion in assertions.iter_source_assertions(build_ctx.entry):
+            with exception_accumulator():
+                assertion_str = parse_utils.reconstruct(assertion.src_ctx)
+                try:
+                    result = find_worst_case(instance_addr, assertion)
+                except assertions.AssertionException:
+                    table.add_row("[red]ERROR[/]", assertion_str, "", "")
+                    raise
+
+                corner_str = _format_corner(result.corner)
+                report.append(
+                    {
+                        "address": instance_addr,
+                        "assertion": assertion_str,
+                        "passes": result.passes,
+                        "numeric": result.numeric,
+                        "corner": {
+                            addr: {"extreme": extreme, "value": value.pretty_str()}
+                            for addr, (extreme, value) in result.corner.items()
+                        },
+                        "evaluations": result.evaluations,
+                    }
+                )
+
+                if result.passes:
+                    table.add_row(
+                        "[green]PASSED[/]", assertion_str, result.numeric, corner_str
+                    )
+                else:
+                    table.add_row(
+                        "[red]FAILED[/]", assertion_str, result.numeric, corner_str
+                    )
+                    raise assertions.AssertionFailed.from_ctx(
+                        assertion.src_ctx,
+                        textwrap.dedent(f"""
+                            address: $addr
+                            assertion: {assertion_str}
+                            worst-case: {result.numeric}
+                        """).strip()
+                        + "\ncorner:\n" + textwrap.indent(corner_str, "  "),
+                        addr=instance_addr,
+                    )
+
+        if report:
+            utils.rich_print(table)
+        else:
+            log.info("No assertions to analyse")
+
+        with open(
+            build_ctx.output_base.with_suffix(".worst-case.json"), "w", encoding="utf-8"
+        ) as f:
+            json.dump({"assertions": report}, f)
@@ -0,0 +1,36 @@
+import textwrap
+from pathlib import Path
+from typing import Callable
+
+import pytest
+
+from atopile import config, front_end, parse
+from atopile.front_end import parser
+
+
+@pytest.fixture
+def load_design(tmp_path: Path, monkeypatch) -> Callable[..., Path]:
+    """
+    Return a function which loads .ato source text, as if it were the file
+    at name in a project in tmp_path, and returns the file's path.
+
+    That project's the current one for the rest of the test, and what's
+    loaded is forgotten afterwards.
+    """
+    monkeypatch.setattr(config, "_project_context", None)
+    config.set_project_context(
+        config.ProjectContext.from_config(config.ProjectConfig(location=tmp_path))
+    )
+    loaded: set[Path] = set()
+
+    def _load(source: str, name: str = "design.ato") -> Path:
+        file = tmp_path / name
+        parser.cache[str(file)] = parse.parse_text_as_file(
+            textwrap.dedent(source), str(file)
+        )
+        loaded.add(file)
+        return file
+
+    yield _load
+    for file in loaded:
+        front_end.reset_caches(file)
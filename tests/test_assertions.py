@@ -0,0 +1,168 @@
+import json
+import math
+from pathlib import Path
+from types import SimpleNamespace
+
+import pint
+import pytest
+
+from atopile import (
+    address,
+    assertions,
+    errors,
+    front_end,
+    instance_methods,
+    overlay,
+)
+
+SOURCE = """
+module Divider:
+    r_top: resistance
+    r_bottom: resistance
+    ratio = r_bottom / (r_top + r_bottom)
+    assert ratio within 0.45 to 0.55
+    assert r_top + r_bottom within 9kohm to 11kohm
+
+module Test:
+    v_in = 5V +/- 1%
+    offset = 1V
+    divider = new Divider
+    v_out = v_in * divider.ratio
+    assert v_out > offset
+"""
+
+
+@pytest.fixture
+def entry(load_design):
+    return str(load_design(SOURCE)) + ":Test"
+
+
+def _names(symbols) -> set[str]:
+    return {s.split("::")[-1] for s in symbols}
+
+
+def test_index(entry, load_design):
+    index = assertions.get_index(entry)
+
+    assert index.instance_addrs == list(instance_methods.all_descendants(entry))
+    assert [_names(a.symbols) for a in index.assertions] == [
+        {"divider.ratio"},
+        {"divider.r_top", "divider.r_bottom"},
+        {"v_out", "offset"},
+    ]
+
+    # Reused until the model's rebuilt
+    assert assertions.get_index(entry) is index
+    front_end.reset_caches(address.get_file(entry))
+    load_design(SOURCE)
+    assert assertions.get_index(entry) is not index
+
+
+def test_simplify_refreshes_symbols(entry):
+    assertions.simplify_expressions(entry)
+    index = assertions.get_index(entry)
+
+    assert [_names(a.symbols) for a in index.assertions] == [
+        {"divider.r_top", "divider.r_bottom"},
+        {"divider.r_top", "divider.r_bottom"},
+        {"divider.r_top", "divider.r_bottom"},
+    ]
+
+
+def test_solve(entry, tmp_path: Path):
+    build_ctx = SimpleNamespace(entry=entry, output_base=tmp_path / "build" / "default")
+    assertions.simplify_expressions(entry)
+    assertions.solve_assertions(build_ctx)
+    assertions.simplify_expressions(entry)
+
+    for indexed in assertions.get_index(entry).assertions:
+        assert not indexed.symbols
+        assert assertions._check_assertion(indexed.assertion, {})
+
+    with open(tmp_path / "build" / "default.solver.json", encoding="utf-8") as f:
+        (group,) = json.load(f)["groups"]
+    assert _names(group["variables"]) == {"divider.r_top", "divider.r_bottom"}
+    assert group["success"]
+    assert group["constraints"] == 5
+    assert group["function_evaluations"] > 0
+    assert group["eseries_candidates"] > 0
+    # Nothing's been solved before to start from
+    assert group["cache_hits"] == 0
+
+
+def test_solutions_kept_in_overlay(entry, tmp_path: Path):
+    build_ctx = SimpleNamespace(entry=entry, output_base=tmp_path / "default")
+    r_top = entry + "::divider.r_top"
+
+    with overlay.activate(overlay.Overlay()):
+        assertions.simplify_expressions(entry)
+        assertions.solve_assertions(build_ctx)
+        assertions.simplify_expressions(entry)
+        assert instance_methods.get_data(r_top)
+        index = assertions.get_index(entry)
+        assert not any(indexed.symbols for indexed in index.assertions)
+
+    # Neither the model nor other builds of it see the solutions
+    with pytest.raises(errors.AtoKeyError):
+        instance_methods.get_data(r_top)
+    with overlay.activate(overlay.Overlay()):
+        assert [_names(a.symbols) for a in assertions.get_index(entry).assertions] == [
+            {"divider.ratio"},
+            {"divider.r_top", "divider.r_bottom"},
+            {"v_out", "offset"},
+        ]
+
+
+def test_solve_warm_starts(entry, load_design, tmp_path: Path):
+    build_ctx = SimpleNamespace(entry=entry, output_base=tmp_path / "default")
+
+    def _solve() -> dict:
+        assertions.simplify_expressions(entry)
+        assertions.solve_assertions(build_ctx)
+        with open(tmp_path / "default.solver.json", encoding="utf-8") as f:
+            (group,) = json.load(f)["groups"]
+        return group
+
+    cold = _solve()
+    assert cold["cache_hits"] == 0
+
+    # Rebuild the model, so the variables are unsolved again
+    front_end.reset_caches(address.get_file(entry))
+    load_design(SOURCE)
+
+    warm = _solve()
+    assert warm["cache_hits"] == 1
+    assert warm["success"]
+
+
+def test_propagate_bounds(entry):
+    assertions.simplify_expressions(entry)
+    group_vars = [entry + "::divider.r_top", entry + "::divider.r_bottom"]
+    translator = assertions._translator_factory(group_vars, [pint.Unit("ohm")] * 2, {})
+    index = assertions.get_index(entry)
+
+    bounds = assertions._propagate_bounds(
+        [indexed.assertion for indexed in index.assertions], translator, [1, 1]
+    )
+
+    # Their sum's at most 11 kohm, so neither can be much more than that
+    for low, high in bounds:
+        assert low == assertions.SEARCH_DECADES[0]
+        assert 10**high / 1.5 < 11e3 < 10**high
+
+    seed = assertions._seed_point(bounds, [1, 1])
+    assert 9e3 < seed[0] + seed[2] < 15e3
+
+
+def test_multi_start_points():
+    bounds = [(0, 7), (2, 4)]
+    points = assertions._multi_start_points(bounds, [1, 1e-3])
+    assert len(points) == assertions.MULTI_START_POINTS
+
+    # Each variable is tried in a different slice of its bounds each time
+    for i, ((low, high), scale) in enumerate(zip(bounds, [1, 1e-3])):
+        centres = [(p[i * 2] + p[i * 2 + 1]) / 2 / scale for p in points]
+        slices = {
+            int((math.log10(c) - low) / (high - low) * len(points)) for c in centres
+        }
+        assert len(slices) == len(points)
@@ -0,0 +1,68 @@
+import stat
+from pathlib import Path
+from types import SimpleNamespace
+
+import pytest
+
+import atopile.cli.build
+from atopile import bom, utils
+
+
+@pytest.fixture
+def entry(load_design):
+    file = load_design(
+        """
+        component Resistor:
+            designator_prefix = "R"
+            footprint = "R0402"
+            mpn = "C25744"
+            value = "10k"
+
+        component Hole:
+            designator_prefix = "H"
+            footprint = "Holes:M3"
+            mpn = "M3"
+            value = "M3"
+
+        module Test:
+            r1 = new Resistor
+            h1 = new Hole
+            r2 = new Resistor
+        """,
+        "bom.ato",
+    )
+    return str(file) + ":Test"
+
+
+def test_bom(entry: str, capsys):
+    assert bom.generate_bom(entry).splitlines() == [
+        "Comment,Designator,Footprint,LCSC",
+        '10k,"R1,R2",R0402,C25744',
+        "M3,H1,Holes:M3,M3",
+    ]
+    assert "more" not in capsys.readouterr().out
+
+
+def test_console_tables_truncated(entry: str, capsys, monkeypatch):
+    monkeypatch.setattr(bom, "MAX_CONSOLE_ROWS", 1)
+
+    # ... but the CSV never is
+    assert len(bom.generate_bom(entry).splitlines()) == 3
+    assert "... and 1 more" in capsys.readouterr().out
+
+    bom.generate_designator_map(entry)
+    printed = capsys.readouterr().out
+    assert "H1" in printed
+    assert "R2" not in printed
+    assert printed.count("... and 2 more") == 2
+
+
+def test_bom_target(entry: str, tmp_path: Path, monkeypatch):
+    monkeypatch.setattr(utils, "_UMASK", 0o022)
+    build_ctx = SimpleNamespace(entry=entry, output_base=tmp_path / "build" / "default")
+    atopile.cli.build.generate_bom(build_ctx)
+
+    bom_path = tmp_path / "build" / "default.csv"
+    with open(bom_path, encoding="utf-8", newline="") as f:
+        assert f.read() == bom.generate_bom(entry)
+    assert stat.S_IMODE(bom_path.stat().st_mode) == 0o644
@@ -0,0 +1,283 @@
+import multiprocessing
+import os
+import pickle
+import threading
+import time
+from pathlib import Path
+from types import SimpleNamespace
+
+import pytest
+
+import atopile.cli.build
+import atopile.version
+from atopile import config, errors, front_end
+from atopile.cli.build import Muster
+
+
+@pytest.fixture
+def muster():
+    return Muster()
+
+
+def _build(
+    muster: Muster, targets, build_ctx=None, force: bool = False
+) -> tuple[list[str], list[Exception]]:
+    err_cltr = errors.ExceptionAccumulator()
+    build_ctx = build_ctx or SimpleNamespace(name="default")
+    built = muster.build(targets, build_ctx, err_cltr.make_collector(), force)
+    return built, err_cltr.errors
+
+
+def test_independent_targets_overlap(muster: Muster):
+    barrier = threading.Barrier(3, timeout=5)
+    for name in "abc":
+        muster.add_target(lambda _: barrier.wait(), name)
+
+    # Each target waits for all the others to start
+    built, errs = _build(muster, ["a", "b", "c"])
+    assert sorted(built) == ["a", "b", "c"]
+    assert not errs
+
+
+def test_targets_built_in_order(muster: Muster):
+    order = []
+    muster.add_target(lambda _: order.append("a"), "a", after=["b"])
+    muster.add_target(lambda _: order.append("b"), "b", after=["c"])
+    muster.add_target(lambda _: order.append("c"), "c")
+    muster.add_target(lambda _: order.append("d"), "d", after=["e"])
+
+    # Targets only wait for the ones being built
+    built, _ = _build(muster, ["a", "b", "c", "d"])
+    assert order.index("c") < order.index("b") < order.index("a")
+    assert sorted(built) == ["a", "b", "c", "d"]
+
+
+def test_declared_order_kept_alongside_other_targets(muster: Muster):
+    spans = {}
+
+    def _target(name: str, delay: float):
+        def _run(_):
+            start = time.monotonic()
+            time.sleep(delay)
+            spans[name] = (start, time.monotonic())
+
+        return _run
+
+    # Registered, and named, in the opposite order to the one they're built in
+    muster.add_target(_target("a", 0), "a", after=["b"])
+    muster.add_target(_target("b", 0.1), "b", after=["c"])
+    muster.add_target(_target("c", 0.2), "c")
+    muster.add_target(_target("d", 0.5), "d")
+
+    built, errs = _build(muster, ["a", "b", "c", "d"])
+    assert sorted(built) == ["a", "b", "c", "d"]
+    assert not errs
+    # Each target starts once the one it's after has finished
+    assert spans["c"][1] <= spans["b"][0]
+    assert spans["b"][1] <= spans["a"][0]
+    # ... without waiting on the others
+    assert spans["a"][1] < spans["d"][1]
+
+
+def test_failures_collected(muster: Muster):
+    def _fail(_):
+        raise errors.AtoError("nope")
+
+    muster.add_target(_fail, "a")
+    muster.add_target(lambda _: None, "b", after=["a"])
+    muster.add_target(lambda _: None, "c", after=["b"])
+    muster.add_target(lambda _: None, "d")
+
+    built, errs = _build(muster, ["a", "b", "c", "d"])
+    # Targets after a failed one aren't built
+    assert built == ["d"]
+    assert [str(e) for e in errs] == ["nope"]
+
+
+def test_cycles(muster: Muster):
+    muster.add_target(lambda _: None, "a", after=["b"])
+    muster.add_target(lambda _: None, "b", after=["a"])
+
+    with pytest.raises(errors.AtoError):
+        _build(muster, ["a", "b"])
+
+
+def test_up_to_date_targets_skipped(muster: Muster, tmp_path: Path, monkeypatch):
+    monkeypatch.setattr(atopile.version, "get_installed_atopile_version", lambda: "1")
+    source = tmp_path / "source.ato"
+    source.write_text("a")
+    output = tmp_path / "default.out"
+    build_ctx = SimpleNamespace(name="default", output_base=tmp_path / "default")
+
+    runs = []
+
+    def _target(_):
+        runs.append(source.read_text())
+        output.write_text(source.read_text())
+
+    muster.add_target(
+        _target, "a", inputs=[lambda _: [source]], outputs=lambda _: [output]
+    )
+
+    def _runs_after_build(force: bool = False) -> int:
+        _build(muster, ["a"], build_ctx, force)
+        return len(runs)
+
+    assert _runs_after_build() == 1
+    assert _runs_after_build() == 1
+
+    # Changed inputs
+    source.write_text("b")
+    assert _runs_after_build() == 2
+
+    # Changed or missing outputs
+    output.write_text("c")
+    assert _runs_after_build() == 3
+    output.unlink()
+    assert _runs_after_build() == 4
+
+    assert _runs_after_build(force=True) == 5
+    assert _runs_after_build() == 5
+
+
+def test_failed_targets_not_recorded(muster: Muster, tmp_path: Path, monkeypatch):
+    monkeypatch.setattr(atopile.version, "get_installed_atopile_version", lambda: "1")
+    build_ctx = SimpleNamespace(name="default", output_base=tmp_path / "default")
+    runs = []
+
+    def _fail(_):
+        runs.append(None)
+        raise errors.AtoError("nope")
+
+    muster.add_target(_fail, "a", inputs=[lambda _: ["x"]], outputs=lambda _: [])
+
+    _, errs = _build(muster, ["a"], build_ctx)
+    assert errs
+    _, errs = _build(muster, ["a"], build_ctx)
+    assert errs
+    assert len(runs) == 2
+
+
+@pytest.mark.skipif(
+    "fork" not in multiprocessing.get_all_start_methods(), reason="Can't fork"
+)
+def test_builds_run_in_forked_processes(load_design, tmp_path: Path, monkeypatch):
+    file = load_design(
+        """
+        component Resistor:
+            designator_prefix = "R"
+
+        module Test:
+            r1 = new Resistor
+        """
+    )
+
+    def _do_build(build_ctx, force):
+        # Each build sees the design elaborated before it was forked
+        assert front_end.lofty._output_cache
+        (tmp_path / build_ctx.name).write_text(str(os.getpid()))
+        if build_ctx.name == "b":
+            raise errors.AtoError("nope")
+
+    monkeypatch.setattr(atopile.cli.build, "_do_build", _do_build)
+    accumulator = errors.ExceptionAccumulator()
+    atopile.cli.build._do_builds(
+        [SimpleNamespace(name=name, entry=f"{file}:Test") for name in "ab"],
+        False,
+        accumulator,
+    )
+
+    pids = {int((tmp_path / name).read_text()) for name in "ab"}
+    assert os.getpid() not in pids
+    assert [str(e) for e in accumulator.errors] == ["nope"]
+
+    # Designators are assigned once, before the builds start
+    assert (tmp_path / config.LOCK_FILE_NAME).exists()
+
+
+def test_designator_errors_dont_stop_builds(monkeypatch):
+    monkeypatch.setattr(atopile.front_end.lofty, "get_instance", lambda _: None)
+
+    def _get_designators(_):
+        raise errors.AtoError("duplicate designator")
+
+    monkeypatch.setattr(
+        atopile.components.designator_manager, "get_designators", _get_designators
+    )
+    built = []
+    monkeypatch.setattr(
+        atopile.cli.build, "_do_build", lambda build_ctx, _: built.append(build_ctx.name)
+    )
+    monkeypatch.setattr(atopile.cli.build, "_can_fork", lambda: False)
+
+    accumulator = errors.ExceptionAccumulator()
+    atopile.cli.build._do_builds(
+        [SimpleNamespace(name=name, entry="a.ato:A") for name in "ab"],
+        False,
+        accumulator,
+    )
+    assert [str(e) for e in accumulator.errors] == ["duplicate designator"]
+    # The targets not using designators can still be built
+    assert built == ["a", "b"]
+
+
+@pytest.mark.skipif(
+    "fork" not in multiprocessing.get_all_start_methods(), reason="Can't fork"
+)
+def test_dead_builds_reported(tmp_path: Path, monkeypatch):
+    monkeypatch.setattr(atopile.front_end.lofty, "get_instance", lambda _: None)
+    monkeypatch.setattr(
+        atopile.components.designator_manager, "get_designators", lambda _: {}
+    )
+
+    def _do_build(build_ctx, force):
+        os._exit(1)
+
+    monkeypatch.setattr(atopile.cli.build, "_do_build", _do_build)
+    accumulator = errors.ExceptionAccumulator()
+    atopile.cli.build._do_builds(
+        [SimpleNamespace(name=name, entry="a.ato:A") for name in "ab"],
+        False,
+        accumulator,
+    )
+    assert accumulator.errors
+    assert all("died" in str(e) for e in accumulator.errors)
+
+
+class _UnpicklableError(Exception):
+    def __reduce__(self):
+        raise TypeError("Can't pickle this")
+
+
+def test_unpicklable_errors_sent_back():
+    error = atopile.cli.build._picklable(_UnpicklableError("nope"))
+    assert isinstance(error, errors.AtoError)
+    assert str(error) == "nope"
+    assert error.title == "_UnpicklableError"
+    pickle.dumps(error)
+
+    # Those that can be are sent back as they are
+    error = errors.AtoError("nope")
+    assert atopile.cli.build._picklable(error) is error
+
+
+def test_source_files_only_the_builds_own(load_design):
+    files = {
+        name: load_design(
+            f"""
+            component Resistor:
+                designator_prefix = "R"
+
+            module {name.upper()}:
+                r1 = new Resistor
+            """,
+            f"{name}.ato",
+        )
+        for name in "ab"
+    }
+    # Both designs are elaborated, like they are when building several configs
+    for name, file in files.items():
+        front_end.lofty.get_instance(f"{file}:{name.upper()}")
+
+    build_ctx = SimpleNamespace(entry=f"{files['a']}:A")
+    assert list(atopile.cli.build._source_files(build_ctx)) == [files["a"]]
@@ -0,0 +1,549 @@
+import json
+import textwrap
+import threading
+import time
+from concurrent.futures import ThreadPoolExecutor
+from contextlib import contextmanager
+from datetime import datetime, timedelta
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from pathlib import Path
+from typing import Optional
+
+import pytest
+
+from atopile import address, components, config, front_end, overlay
+
+
+class ComponentServer(ThreadingHTTPServer):
+    """A stand-in for the components service."""
+
+    def __init__(
+        self, batch: bool = True, delay: float = 0, failures: int = 0, port: int = 0
+    ) -> None:
+        # Cached components are only shared by servers at the same URL
+        super().__init__(("127.0.0.1", port), _Handler)
+        self.batch = batch
+        self.requests: list[tuple[str, object]] = []
+        self.headers: list[dict[str, str]] = []
+        # Seconds to take over each request
+        self.delay = delay
+        # How many requests to fail, before behaving
+        self.failures = failures
+        self.in_flight = 0
+        self.max_in_flight = 0
+        # The version of the components, for conditional requests
+        self.etag: Optional[str] = None
+        self.lock = threading.Lock()
+
+    @property
+    def url(self) -> str:
+        return f"http://127.0.0.1:{self.server_address[1]}/jlc/v1"
+
+    @staticmethod
+    def lookup(spec: dict):
+        value = f"{spec['value']['nominal']:g} {spec['value']['unit']}"
+        if spec["value"]["unit"] == "microohm":
+            # Nothing so small in stock
+            return {}
+        return {
+            "bestComponent": {
+                "lcsc_id": value,
+                "description": value,
+                "footprint": {"kicad": f"R{spec['package']}.kicad_mod"},
+                "footprint_data": {"kicad": f"(footprint R{spec['package']})"},
+            }
+        }
+
+
+class _Handler(BaseHTTPRequestHandler):
+    server: ComponentServer
+
+    def do_POST(self):
+        body = json.loads(self.rfile.read(int(self.headers["Content-Length"])))
+        with self.server.lock:
+            self.server.requests.append((self.path, body))
+            self.server.headers.append(dict(self.headers))
+            self.server.in_flight += 1
+            self.server.max_in_flight = max(
+                self.server.max_in_flight, self.server.in_flight
+            )
+            fail = self.server.failures > 0
+            self.server.failures -= 1
+
+        try:
+            time.sleep(self.server.delay)
+            self._respond(body, fail)
+        finally:
+            with self.server.lock:
+                self.server.in_flight -= 1
+
+    def _respond(self, body, fail: bool):
+        if fail:
+            self.send_error(503)
+            return
+        elif self.server.etag and self.headers.get("If-None-Match") == self.server.etag:
+            self.send_response(304)
+            self.end_headers()
+            return
+        elif self.path == "/jlc/v1/batch" and self.server.batch:
+            response = {"components": [self.server.lookup(s) for s in body["components"]]}
+            if self.server.etag:
+                for component in response["components"]:
+                    component["etag"] = self.server.etag
+        elif self.path == "/jlc/v1":
+            response = self.server.lookup(body)
+        else:
+            self.send_error(404)
+            return
+
+        data = json.dumps(response).encode()
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        if self.server.etag:
+            self.send_header("ETag", self.server.etag)
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+
+    def log_message(self, *args):
+        pass
+
+
+@contextmanager
+def _serve(
+    server: ComponentServer,
+    project_path: Path,
+    cache_path: Optional[Path] = None,
+    **services,
+):
+    thread = threading.Thread(target=server.serve_forever, daemon=True)
+    thread.start()
+
+    old_context = config._project_context
+    config.set_project_context(
+        config.ProjectContext.from_config(
+            config.ProjectConfig(
+                location=project_path,
+                services=config.ProjectServicesConfig(components=server.url, **services),
+            )
+        )
+    )
+    old_cache_path = components.CACHE_PATH
+    components.CACHE_PATH = cache_path or project_path / "component_cache.db"
+    old_footprint_store = components.FOOTPRINT_STORE
+    components.FOOTPRINT_STORE = project_path / "footprint_store"
+    components._component_cache = None
+    components._migrated_projects.clear()
+    components._unmatched_specs().clear()
+
+    try:
+        yield server
+    finally:
+        server.shutdown()
+        server.server_close()
+        config.set_project_context(old_context)
+        if components._component_cache is not None:
+            components._component_cache.close()
+        components._component_cache = None
+        components.CACHE_PATH = old_cache_path
+        components.FOOTPRINT_STORE = old_footprint_store
+
+
+@pytest.fixture(params=[True, False], ids=["batch", "no-batch"])
+def server(request, load_design, tmp_path: Path):
+    # After the design's loaded, which would replace the server's project
+    with _serve(ComponentServer(batch=request.param), tmp_path) as server:
+        yield server
+
+
+@pytest.fixture
+def entry(load_design):
+    file = load_design(
+        """
+        component Resistor:
+            mpn = "generic_resistor"
+            footprint = "R0402"
+            value: resistance
+
+        module Test:
+            r1 = new Resistor
+            r1.value = 10kohm +/- 1%
+            r2 = new Resistor
+            r2.value = 10kohm +/- 1%
+            r3 = new Resistor
+            r3.value = 1kohm +/- 1%
+            r4 = new Resistor
+            r4.value = 1mohm +/- 1%
+        """
+    )
+    module = str(file) + ":Test"
+    # Builds always start by elaborating their entry
+    front_end.lofty.get_instance(module)
+    return module
+
+
+def test_generics_fetched_together(server: ComponentServer, entry: str):
+    assert components.get_mpn(entry + "::r1") == "10 kiloohm"
+    assert components.get_user_facing_value(entry + "::r3") == "1000 ohm"
+
+    if server.batch:
+        # One request for all the distinct specs in the design
+        ((path, body),) = server.requests
+        assert path == "/jlc/v1/batch"
+        assert len(body["components"]) == 3
+    else:
+        # The batch request fails, so each is looked up on its own
+        assert [path for path, _ in server.requests] == ["/jlc/v1/batch"] + ["/jlc/v1"] * 3
+
+    # Identical specs share the result
+    assert components.get_mpn(entry + "::r2") == "10 kiloohm"
+    requests_so_far = len(server.requests)
+
+    with pytest.raises(components.NoMatchingComponent):
+        components.get_mpn(entry + "::r4")
+    # We already know there's no match
+    assert len(server.requests) == requests_so_far
+
+    # Results are cached for the next build, once for each distinct spec
+    cache = components.ComponentCache(components.CACHE_PATH)
+    assert len(cache) == 2
+
+
+def test_unmatched_specs_looked_up_next_build(server: ComponentServer, entry: str):
+    with overlay.activate(overlay.Overlay()):
+        with pytest.raises(components.NoMatchingComponent):
+            components.get_mpn(entry + "::r4")
+    requests_so_far = len(server.requests)
+
+    # There might be a match by the next build
+    with overlay.activate(overlay.Overlay()):
+        with pytest.raises(components.NoMatchingComponent):
+            components.get_mpn(entry + "::r4")
+    assert len(server.requests) > requests_so_far
+
+
+def test_lookups_are_concurrent(entry: str, tmp_path: Path):
+    with _serve(ComponentServer(batch=False, delay=0.2), tmp_path) as server:
+        assert components.get_mpn(entry + "::r1") == "10 kiloohm"
+    assert server.max_in_flight == 3
+
+
+def test_server_errors_are_retried(entry: str, tmp_path: Path, monkeypatch):
+    monkeypatch.setattr(components, "RETRY_BACKOFF", 0)
+    components._get_session.cache_clear()
+    with _serve(ComponentServer(failures=2), tmp_path) as server:
+        assert components.get_mpn(entry + "::r1") == "10 kiloohm"
+    assert [path for path, _ in server.requests] == ["/jlc/v1/batch"] * 3
+    components._get_session.cache_clear()
+
+
+def test_cache_shared_between_projects(entry: str, tmp_path: Path):
+    cache_path = tmp_path / "component_cache.db"
+    with _serve(ComponentServer(), tmp_path / "a", cache_path) as server:
+        assert components.get_mpn(entry + "::r1") == "10 kiloohm"
+    assert len(server.requests) == 1
+    port = server.server_address[1]
+
+    # Another project's identical specs don't need looking up again
+    components._get_generic_from_db.cache_clear()
+    components._batched_entries().clear()
+    with _serve(ComponentServer(port=port), tmp_path / "b", cache_path) as server:
+        assert components.get_mpn(entry + "::r2") == "10 kiloohm"
+        assert components.get_mpn(entry + "::r3") == "1000 ohm"
+    assert not server.requests
+
+    # ... but not those picked by another components service
+    components._get_generic_from_db.cache_clear()
+    components.get_mpn.cache_clear()
+    components._batched_entries().clear()
+    with _serve(ComponentServer(), tmp_path / "c", cache_path) as server:
+        assert components.get_mpn(entry + "::r2") == "10 kiloohm"
+    assert server.requests
+
+
+def test_component_table(server: ComponentServer, entry: str):
+    table = components.get_component_table(entry)
+    assert [addr.split("::")[-1] for addr in table] == ["r1", "r2", "r3", "r4"]
+    assert table[entry + "::r1"].mpn == "10 kiloohm"
+    assert table[entry + "::r3"].footprint == "R0402"
+    assert table[entry + "::r3"].designator == "U3"
+
+    # Errors looking attributes up are raised where they're used, each time
+    with pytest.raises(components.NoMatchingComponent) as first:
+        table[entry + "::r4"].mpn
+    with pytest.raises(components.NoMatchingComponent) as second:
+        table[entry + "::r4"].mpn
+    assert first.value is not second.value
+    assert table[entry + "::r4"].designator == "U4"
+
+    # And everything's only looked up once per build
+    assert components.get_component_table(entry) is table
+
+
+def test_component_table_looked_up_lazily(server: ComponentServer, entry: str):
+    table = components.get_component_table(entry)
+    assert table[entry + "::r1"].designator == "U1"
+    # Nothing needed selecting components
+    assert not server.requests
+
+
+def test_footprints_materialized_once(entry: str, tmp_path: Path, monkeypatch):
+    footprint_dir = tmp_path / "footprints.pretty"
+    writes = []
+    write_if_changed = components.utils.write_if_changed
+
+    def _write_if_changed(path, content):
+        written = write_if_changed(path, content)
+        if written and path.parent == footprint_dir:
+            writes.append(path.name)
+        return written
+    monkeypatch.setattr(components.utils, "write_if_changed", _write_if_changed)
+
+    addrs = [entry + f"::r{i}" for i in range(1, 4)]
+    with _serve(ComponentServer(), tmp_path):
+        components.materialize_footprints(addrs, footprint_dir)
+        # All the resistors share a footprint
+        assert writes == ["R0402.kicad_mod"]
+        assert (footprint_dir / "R0402.kicad_mod").read_text() == "(footprint R0402)"
+        assert len(list((tmp_path / "footprint_store").iterdir())) == 1
+
+        # Unchanged footprints aren't rewritten
+        components.materialize_footprints(addrs, footprint_dir)
+        assert writes == ["R0402.kicad_mod"]
+
+
+def test_prefetch(entry: str, tmp_path: Path):
+    with _serve(ComponentServer(), tmp_path / "warm", tmp_path / "cache.db") as server:
+        assert components.prefetch(entry) == 4
+        assert len(server.requests) == 1
+    assert len(list((tmp_path / "warm" / "footprint_store").iterdir())) == 1
+    port = server.server_address[1]
+
+    # Later builds are served entirely from the cache
+    components._get_generic_from_db.cache_clear()
+    components._batched_entries().clear()
+    with _serve(
+        ComponentServer(port=port), tmp_path / "build", tmp_path / "cache.db"
+    ) as server:
+        for i in range(1, 4):
+            components.get_mpn(entry + f"::r{i}")
+    assert not server.requests
+
+
+def test_local_parts_index(entry: str, tmp_path: Path):
+    (tmp_path / "parts.json").write_text(
+        json.dumps({
+            "components": [
+                {
+                    "lcsc_id": "C25744",
+                    "type": "resistor",
+                    "package": "0402",
+                    "description": "10kΩ ±1% 0402",
+                    "value": {"unit": "ohm", "min_val": 9900, "max_val": 10100},
+                },
+            ]
+        })
+    )
+
+    with _serve(ComponentServer(), tmp_path, components_index="parts.json") as server:
+        assert components.get_mpn(entry + "::r1") == "C25744"
+        with pytest.raises(components.NoMatchingComponent):
+            components.get_mpn(entry + "::r3")
+    assert not server.requests
+
+
+def test_prefetch_with_local_parts_index(entry: str, tmp_path: Path):
+    (tmp_path / "parts.json").write_text(json.dumps({"components": []}))
+
+    with _serve(ComponentServer(), tmp_path, components_index="parts.json") as server:
+        assert components.prefetch(entry) == 4
+        # Builds only use the local index, so there's nothing to fetch
+        assert not server.requests
+        assert len(components.ComponentCache(components.CACHE_PATH)) == 0
+
+
+@pytest.mark.parametrize("changed", [True, False], ids=["changed", "unchanged"])
+def test_stale_while_revalidate(entry: str, tmp_path: Path, changed: bool):
+    server = ComponentServer()
+    server.etag = "v2"
+    with _serve(server, tmp_path, components_stale_while_revalidate=True):
+        spec_key = components._spec_key(components._get_specd_data_dict(entry + "::r1"))
+        stale = (datetime.now() - timedelta(days=20)).timestamp()
+        components.get_component_cache().put(
+            spec_key,
+            {"data": {"lcsc_id": "C1"}, "timestamp": stale, "etag": "v1" if changed else "v2"},
+        )
+
+        # The stale component's used straight away
+        assert components.get_mpn(entry + "::r1") == "C1"
+        components.wait_for_revalidation()
+
+        (path, _), = server.requests
+        assert path == "/jlc/v1"
+        assert server.headers[0]["If-None-Match"] == ("v1" if changed else "v2")
+
+        cached = components.get_component_cache().get(spec_key)
+        assert cached["timestamp"] > stale
+        assert cached["etag"] == "v2"
+        assert cached["data"]["lcsc_id"] == ("10 kiloohm" if changed else "C1")
+
+
+@pytest.mark.parametrize("batch", [True, False], ids=["batch", "no-batch"])
+def test_first_revalidation_is_conditional(entry: str, tmp_path: Path, batch: bool):
+    server = ComponentServer(batch=batch)
+    server.etag = "v1"
+    with _serve(server, tmp_path, components_stale_while_revalidate=True):
+        assert components.get_mpn(entry + "::r1") == "10 kiloohm"
+        spec_key = components._spec_key(components._get_specd_data_dict(entry + "::r1"))
+        assert components.get_component_cache().get(spec_key)["etag"] == "v1"
+
+        # Next time it's used, it's gone stale
+        stale = (datetime.now() - timedelta(days=20)).timestamp()
+        components.get_component_cache().touch(spec_key, stale)
+        components._get_generic_from_db.cache_clear()
+        components.get_mpn.cache_clear()
+        server.requests.clear()
+        server.headers.clear()
+
+        assert components.get_mpn(entry + "::r1") == "10 kiloohm"
+        components.wait_for_revalidation()
+        assert [path for path, _ in server.requests] == ["/jlc/v1"]
+        assert server.headers[0]["If-None-Match"] == "v1"
+
+
+def test_stale_components_refetched(entry: str, tmp_path: Path):
+    with _serve(ComponentServer(), tmp_path) as server:
+        spec_key = components._spec_key(components._get_specd_data_dict(entry + "::r1"))
+        stale = (datetime.now() - timedelta(days=20)).timestamp()
+        components.get_component_cache().put(
+            spec_key, {"data": {"lcsc_id": "C1"}, "timestamp": stale}
+        )
+
+        # Unless the project allows it, stale components are fetched again first
+        assert components.get_mpn(entry + "::r1") == "10 kiloohm"
+    assert server.requests
+
+
+def _entry(lcsc_id: str, age: timedelta = timedelta()) -> dict:
+    return {
+        "data": {"lcsc_id": lcsc_id},
+        "timestamp": (datetime.now() - age).timestamp(),
+        "address_data": {"value": lcsc_id},
+    }
+
+
+def test_cache_is_shared(tmp_path: Path):
+    path = tmp_path / "component_cache.db"
+    a = components.ComponentCache(path)
+    b = components.ComponentCache(path)
+
+    a.put("1", _entry("C1"))
+    assert b.get("1")["data"] == {"lcsc_id": "C1"}
+
+    # Nothing's visible to others until the transaction's over
+    with b.transaction():
+        b.put("2", _entry("C2"))
+        assert "2" not in a
+    assert "2" in a
+
+    # Including from other threads
+    with ThreadPoolExecutor(4) as executor:
+        list(executor.map(lambda i: a.put(str(i), _entry(f"C{i}")), range(3, 20)))
+    assert len(b) == 19
+
+
+def test_cache_migrated_from_json(tmp_path: Path):
+    cache_dir = tmp_path / ".ato"
+    cache_dir.mkdir()
+    (cache_dir / "component_cache.json").write_text(
+        json.dumps({
+            "a.ato:A::r1": _entry("C1"),
+            "a.ato:A::r2": _entry("C2", timedelta(days=15)),
+        })
+    )
+
+    with _serve(ComponentServer(), tmp_path):
+        assert components.get_component_from_cache("a.ato:A::r1", {"value": "C1"}) == {
+            "lcsc_id": "C1"
+        }
+        # Stale entries are left behind
+        assert components.get_component_from_cache("a.ato:A::r2", {"value": "C2"}) is None
+
+    assert not (cache_dir / "component_cache.json").exists()
+
+
+def _load_designators_module(load_design, body: str) -> str:
+    file = load_design(
+        """
+        component Resistor:
+            designator_prefix = "R"
+
+        component LED:
+            designator_prefix = "LED"
+
+        module Test:
+        """
+        + textwrap.indent(textwrap.dedent(body), "            ")
+    )
+    module = str(file) + ":Test"
+    front_end.lofty.get_instance(module)
+    return module
+
+
+def test_designators_are_locked(load_design):
+    module = _load_designators_module(load_design, """
+        r1 = new Resistor
+        r1.designator = "R2"
+        r2 = new Resistor
+        r3 = new Resistor
+        d1 = new LED
+        """)
+    designators = {
+        name: components.get_designator(f"{module}::{name}")
+        for name in ["r1", "r2", "r3", "d1"]
+    }
+    assert designators == {"r1": "R2", "r2": "R1", "r3": "R3", "d1": "LED1"}
+
+    lock_data = components.yaml.load(config.get_project_context().lock_file_path)
+    assert set(lock_data["designators"].values()) == {"R1", "R3", "LED1"}
+
+    # Removing and adding components doesn't renumber the others
+    front_end.reset_caches(address.get_file(module))
+    _load_designators_module(load_design, """
+        r3 = new Resistor
+        r4 = new Resistor
+        d1 = new LED
+        """)
+    designators = {
+        name: components.get_designator(f"{module}::{name}")
+        for name in ["r3", "r4", "d1"]
+    }
+    assert designators == {"r3": "R3", "r4": "R1", "d1": "LED1"}
+
+    lock_data = components.yaml.load(config.get_project_context().lock_file_path)
+    assert set(lock_data["designators"].values()) == {"R1", "R3", "LED1"}
+
+
+def test_designators_kept_alongside_concurrent_writes(load_design):
+    module = _load_designators_module(load_design, """
+        r1 = new Resistor
+        """)
+    lock_file_path = config.get_project_context().lock_file_path
+
+    # Like another build, holding the lock file while this one starts
+    with ThreadPoolExecutor(1) as executor:
+        with components.utils.file_lock(
+            components._lock_file_lock_path(lock_file_path)
+        ):
+            future = executor.submit(components.get_designator, module + "::r1")
+            time.sleep(0.1)
+            components.yaml.dump(
+                {"designators": {"other.ato:Other::r1": "R9"}}, lock_file_path
+            )
+        assert future.result() == "R1"
+
+    lock_data = components.yaml.load(lock_file_path)
+    assert lock_data["designators"] == {
+        "other.ato:Other::r1": "R9",
+        "design.ato:Test::r1": "R1",
+    }
@@ -1,3 +1,4 @@
+import pytest
 from atopile import config
 from ruamel.yaml import YAML
 import copy
@@ -32,3 +33,35 @@ def test_roundtrip():
     config_dict_2["dependencies"][2] = {'name': 'esp32-s3', 'version_spec': None, 'link_broken': False, 'path': '../esp32-s3'}
     config_dict_2["dependencies"][1] = {'name': 'usb-connectors', 'version': '^v0.0.1', 'path': 'test'}
     assert config_dict_2 == cfg.patch_config(config_dict)
+
+
+def test_components_concurrency_validated():
+    config_dict = yaml.load("""
+        ato-version: ^0.2.0
+        services:
+            components_concurrency: 0
+        """)
+    with pytest.raises(config.AtoConfigError, match="components_concurrency"):
+        config.ProjectConfig.structure(config_dict)
+
+    with pytest.raises(ValueError):
+        config.ProjectServicesConfig(components_concurrency=0)
+
+
+@pytest.mark.parametrize(
+    "build, key",
+    [
+        ("monte_carlo_samples: 0", "monte_carlo_samples"),
+        ("monte_carlo_distribution: normal", "monte_carlo_distribution"),
+    ],
+)
+def test_monte_carlo_validated(build: str, key: str):
+    config_dict = yaml.load(f"""
+        ato-version: ^0.2.0
+        builds:
+            default:
+                entry: elec/src/default.ato:Default
+                {build}
+        """)
+    with pytest.raises(config.AtoConfigError, match=key):
+        config.ProjectConfig.structure(config_dict)
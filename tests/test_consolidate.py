@@ -0,0 +1,113 @@
+import json
+import os
+import shutil
+import stat
+import sys
+from concurrent.futures import ThreadPoolExecutor
+from pathlib import Path
+
+import pytest
+
+from atopile import consolidate
+
+
+@pytest.fixture
+def project(tmp_path: Path) -> Path:
+    project = tmp_path / "project"
+    (project / "elec" / "footprints").mkdir(parents=True)
+    (project / ".ato" / "modules" / "dep").mkdir(parents=True)
+    (project / "build" / "footprints").mkdir(parents=True)
+    (project / "elec" / "footprints" / "R0402.kicad_mod").write_text(
+        '(footprint R0402 (model "{build_dir}/R0402.step"))'
+    )
+    (project / ".ato" / "modules" / "dep" / "USB.kicad_mod").write_text("(footprint USB)")
+    (project / "elec" / "footprints" / "R0402.step").write_bytes(b"solid" * 1000)
+    # Outputs of earlier builds aren't sources
+    (project / "build" / "footprints" / "Old.kicad_mod").write_text("(footprint Old)")
+    return project
+
+
+def _sync(project: Path) -> tuple[Path, Path]:
+    footprints = project / "build" / "footprints" / "footprints.pretty"
+    models = project / "build" / "footprints" / "footprints.3dshapes"
+    consolidate.consolidate_footprints(project, footprints, models)
+    consolidate.consolidate_3dmodels(project, models)
+    return footprints, models
+
+
+def test_consolidate(project: Path):
+    footprints, models = _sync(project)
+
+    assert sorted(p.name for p in footprints.glob("*.kicad_mod")) == [
+        "R0402.kicad_mod",
+        "USB.kicad_mod",
+    ]
+    assert (footprints / "R0402.kicad_mod").read_text() == (
+        f'(footprint R0402 (model "{models}/R0402.step"))'
+    )
+    assert (models / "R0402.step").read_bytes() == b"solid" * 1000
+
+
+def test_only_changes_synced(project: Path, monkeypatch):
+    _sync(project)
+
+    put = []
+    link_or_copy = consolidate.link_or_copy
+    write_if_changed = consolidate.utils.write_if_changed
+
+    def _link_or_copy(src, dst):
+        put.append(dst.name)
+        link_or_copy(src, dst)
+
+    def _write_if_changed(path, content):
+        if path.suffix == ".kicad_mod":
+            put.append(path.name)
+        return write_if_changed(path, content)
+
+    monkeypatch.setattr(consolidate, "link_or_copy", _link_or_copy)
+    monkeypatch.setattr(consolidate.utils, "write_if_changed", _write_if_changed)
+
+    footprints, models = _sync(project)
+    assert put == []
+
+    # Changed sources are synced again
+    (project / "elec" / "footprints" / "R0402.step").write_bytes(b"solider")
+    footprints, models = _sync(project)
+    assert put == ["R0402.step"]
+    assert (models / "R0402.step").read_bytes() == b"solider"
+
+    # As are changed copies
+    put.clear()
+    (footprints / "USB.kicad_mod").write_text("oops")
+    _sync(project)
+    assert put == ["USB.kicad_mod"]
+    assert (footprints / "USB.kicad_mod").read_text() == "(footprint USB)"
+
+    # And ones whose sources are gone are removed
+    (project / ".ato" / "modules" / "dep" / "USB.kicad_mod").unlink()
+    _sync(project)
+    assert not (footprints / "USB.kicad_mod").exists()
+
+
+@pytest.mark.skipif(not sys.platform.startswith("linux"), reason="Reflinks")
+def test_reflinks_keep_mode(tmp_path: Path, monkeypatch):
+    # Stands in for a filesystem which can reflink
+    monkeypatch.setattr(consolidate, "_reflink", shutil.copyfile)
+    src = tmp_path / "R0402.step"
+    src.write_bytes(b"solid")
+    os.chmod(src, 0o644)
+
+    consolidate.link_or_copy(src, tmp_path / "copy.step")
+    assert (tmp_path / "copy.step").read_bytes() == b"solid"
+    assert stat.S_IMODE((tmp_path / "copy.step").stat().st_mode) == 0o644
+
+
+def test_concurrent_syncs(project: Path):
+    # Like builds of several configs at once
+    with ThreadPoolExecutor(4) as executor:
+        list(executor.map(lambda _: _sync(project), range(8)))
+
+    footprints, models = _sync(project)
+    manifest = json.loads((footprints / consolidate.MANIFEST_NAME).read_text())
+    assert sorted(manifest) == ["R0402.kicad_mod", "USB.kicad_mod"]
+    assert (models / "R0402.step").read_bytes() == b"solid" * 1000
@@ -0,0 +1,89 @@
+from concurrent.futures import ThreadPoolExecutor
+from pathlib import Path
+
+import pytest
+from git import Repo
+
+from atopile import config
+from atopile.cli import install
+
+
+@pytest.fixture
+def origin(tmp_path: Path) -> str:
+    repo = Repo.init(tmp_path / "origin" / "some-module", initial_branch="main")
+    with repo.config_writer() as cw:
+        cw.set_value("user", "name", "test")
+        cw.set_value("user", "email", "test@example.com")
+
+    for tag in ["v0.1.0", "v0.1.1", "v0.2.0"]:
+        (Path(repo.working_dir) / "version.txt").write_text(tag)
+        repo.index.add(["version.txt"])
+        repo.index.commit(tag)
+        repo.create_tag(tag)
+
+    (Path(repo.working_dir) / "version.txt").write_text("unreleased")
+    repo.index.add(["version.txt"])
+    repo.index.commit("unreleased")
+
+    return Path(repo.working_dir).as_uri()
+
+
+@pytest.fixture(autouse=True)
+def mirror_dir(tmp_path: Path, monkeypatch):
+    monkeypatch.setattr(install, "MIRROR_DIR", tmp_path / "mirrors")
+    return tmp_path / "mirrors"
+
+
+def _install(origin: str, spec: str, path: Path, upgrade: bool = False) -> Path:
+    dependency = config.Dependency(name=origin, version_spec=spec)
+    install.install_dependency(dependency, upgrade, path)
+    return path
+
+
+def test_shallow_install(origin: str, tmp_path: Path, mirror_dir: Path):
+    path = _install(origin, "~0.1.0", tmp_path / "project" / "some-module")
+    assert (path / "version.txt").read_text() == "v0.1.1"
+
+    # Only the commit we need is checked out
+    repo = Repo(path)
+    assert (Path(repo.git_dir) / "shallow").exists()
+    assert len(list(repo.iter_commits())) == 1
+    # But it still points at the real remote
+    assert repo.remotes.origin.url == origin
+
+    # Other projects share the mirror
+    _install(origin, "^0.2.0", tmp_path / "other-project" / "some-module")
+    (mirror,) = mirror_dir.glob("*.git")
+    assert len(Repo(mirror).tags) == 3
+
+
+def test_concurrent_installs(origin: str, tmp_path: Path, mirror_dir: Path):
+    # Like several projects installing at once, sharing the mirror
+    paths = [tmp_path / f"project-{i}" / "some-module" for i in range(4)]
+    with ThreadPoolExecutor(4) as executor:
+        list(executor.map(lambda path: _install(origin, "^0.2.0", path), paths))
+
+    for path in paths:
+        assert (path / "version.txt").read_text() == "v0.2.0"
+    (mirror,) = mirror_dir.glob("*.git")
+    assert len(Repo(mirror).tags) == 3
+
+
+def test_upgrade(origin: str, tmp_path: Path):
+    path = _install(origin, "~0.1.0", tmp_path / "some-module")
+
+    origin_repo = Repo(origin.removeprefix("file://"))
+    origin_repo.create_tag("v0.1.2")
+
+    # Not without asking
+    _install(origin, "~0.1.0", path)
+    assert (path / "version.txt").read_text() == "v0.1.1"
+
+    _install(origin, "~0.1.0", path, upgrade=True)
+    assert (path / "version.txt").read_text() == "unreleased"
+
+
+def test_install_commit(origin: str, tmp_path: Path):
+    first = Repo(origin.removeprefix("file://")).tags["v0.1.0"].commit.hexsha
+    path = _install(origin, f"@{first}", tmp_path / "some-module")
+    assert (path / "version.txt").read_text() == "v0.1.0"
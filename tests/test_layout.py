@@ -0,0 +1,121 @@
+import json
+import os
+from pathlib import Path
+from types import SimpleNamespace
+
+import pytest
+
+from atopile import layout
+
+
+def _write_config(path: Path, entry: str):
+    path.parent.mkdir(parents=True, exist_ok=True)
+    path.write_text(
+        "ato-version: ^0.2.0\n"
+        "builds:\n"
+        "  default:\n"
+        f"    entry: {entry}\n"
+    )
+
+
+@pytest.fixture
+def project(load_design, tmp_path: Path):
+    _write_config(tmp_path / "ato.yaml", "elec/src/top.ato:Top")
+    _write_config(
+        tmp_path / ".ato" / "modules" / "dep" / "ato.yaml", "dep.ato:Dep"
+    )
+    # Not a project, so never indexed
+    _write_config(tmp_path / "build" / "ato.yaml", "nope.ato:Nope")
+    return tmp_path
+
+
+def _count_parses(monkeypatch) -> list[Path]:
+    parsed = []
+    index_config = layout._index_config
+
+    def _index_config(config_path):
+        parsed.append(config_path)
+        return index_config(config_path)
+
+    monkeypatch.setattr(layout, "_index_config", _index_config)
+    return parsed
+
+
+def test_find_module_layouts(project: Path, monkeypatch):
+    parsed = _count_parses(monkeypatch)
+    dep_path = project / ".ato" / "modules" / "dep"
+
+    laid_out = layout._find_module_layouts()
+    dep_entry = str(dep_path / "dep.ato:Dep")
+    assert set(laid_out) == {str(project / "elec/src/top.ato:Top"), dep_entry}
+    (dep_build,) = laid_out[dep_entry]
+    assert dep_build.name == "default"
+    assert dep_build.layout_base == dep_path / "elec/layout/default"
+    assert len(parsed) == 2
+
+    # Unchanged configs aren't parsed again
+    assert layout._find_module_layouts() == laid_out
+    assert len(parsed) == 2
+
+    # ... but changed ones are, in the same process
+    _write_config(dep_path / "ato.yaml", "other.ato:Other")
+    stat = (dep_path / "ato.yaml").stat()
+    os.utime(dep_path / "ato.yaml", ns=(stat.st_atime_ns, stat.st_mtime_ns + 1))
+    laid_out = layout._find_module_layouts()
+    assert str(dep_path / "other.ato:Other") in laid_out
+    assert dep_entry not in laid_out
+    assert len(parsed) == 3
+
+    # ... and so are new ones
+    _write_config(project / ".ato" / "modules" / "new" / "ato.yaml", "new.ato:New")
+    assert str(project / ".ato/modules/new/new.ato:New") in layout._find_module_layouts()
+    assert len(parsed) == 4
+
+
+def test_module_map_matches_by_path(project: Path, load_design, monkeypatch):
+    file = load_design(
+        """
+        component Resistor:
+            designator_prefix = "R"
+
+        module Filter:
+            r2 = new Resistor
+            r1 = new Resistor
+
+        module LaidOutFilter:
+            r1 = new Resistor
+            r2 = new Resistor
+
+        module Top:
+            f1 = new Filter
+            f2 = new Filter
+        """,
+        "elec/src/top.ato",
+    )
+    # The laid out module has its children in another order
+    laid_out_entry = str(file) + ":LaidOutFilter"
+    monkeypatch.setattr(
+        layout,
+        "_find_module_layouts",
+        lambda: {
+            str(file) + ":Filter": [
+                layout.LaidOutModule("filter", laid_out_entry, project / "nope")
+            ]
+        },
+    )
+    build_ctx = SimpleNamespace(
+        entry=str(file) + ":Top", output_base=project / "build" / "default"
+    )
+    layout.generate_module_map(build_ctx)
+
+    module_map = json.loads((project / "build" / "default.layouts.json").read_text())
+    assert set(module_map) == {"f1", "f2"}
+    uid = layout.generate_uuid_from_string
+    assert module_map["f1"]["uuid_map"] == {
+        uid("f1.r1"): uid("r1"),
+        uid("f1.r2"): uid("r2"),
+    }
+    assert module_map["f2"]["uuid_map"] == {
+        uid("f2.r1"): uid("r1"),
+        uid("f2.r2"): uid("r2"),
+    }
@@ -0,0 +1,127 @@
+import json
+import stat
+import sys
+import textwrap
+import zipfile
+from pathlib import Path
+from types import SimpleNamespace
+
+import pytest
+import semver
+
+from atopile import config, manufacturing_data, utils
+
+# Stands in for kicad-cli, noting when each export runs, and
+# writing something like what it would
+STUB = textwrap.dedent(
+    """
+    import json, sys, time
+    from pathlib import Path
+
+    args = sys.argv[1:]
+    start = time.time()
+    time.sleep(0.3)
+    out = Path(args[args.index("-o") + 1])
+    if args[2] == "gerbers":
+        (out / "board-F_Cu.gtl").write_text("gerber")
+        (out / "board-B_Cu.gbl").write_text("gerber")
+    elif args[2] == "drill":
+        (out / "board.drl").write_text("drill")
+    elif args[2] == "pos":
+        out.write_text("Ref,Val,Package,PosX,PosY,Rot,Side\\nR1,10k,R0402,1,2,0,top\\n")
+    with open(Path(__file__).with_suffix(".log"), "a") as log:
+        log.write(json.dumps([args[2], start, time.time()]) + "\\n")
+    """
+)
+
+
+@pytest.fixture
+def kicad_cli(tmp_path: Path, monkeypatch) -> Path:
+    stub = tmp_path / "kicad_cli.py"
+    stub.write_text(STUB)
+    monkeypatch.setattr(manufacturing_data, "find_kicad_cli", lambda: sys.executable)
+    monkeypatch.setattr(
+        manufacturing_data, "get_cli_version", lambda _: semver.Version(8, 0, 0)
+    )
+
+    # Run the stub with this interpreter, in place of the real thing
+    run = manufacturing_data.run
+
+    def _run(args, **kwargs):
+        run([args[0], str(stub), *args[1:]], **kwargs)
+
+    monkeypatch.setattr(manufacturing_data, "run", _run)
+    return stub.with_suffix(".log")
+
+
+@pytest.fixture
+def build_ctx(tmp_path: Path):
+    old_context = config._project_context
+    config.set_project_context(
+        config.ProjectContext.from_config(config.ProjectConfig(location=tmp_path))
+    )
+    layout = tmp_path / "layout.kicad_pcb"
+    layout.write_text("(kicad_pcb {{GITHASH}})")
+    yield SimpleNamespace(
+        layout_path=layout,
+        build_path=tmp_path / "build",
+        output_base=tmp_path / "build" / "default",
+    )
+    config.set_project_context(old_context)
+    manufacturing_data._ensure_modded_kicad_pcb_cache.clear()
+
+
+def _exports(log: Path) -> list:
+    if not log.exists():
+        return []
+    return [json.loads(line) for line in log.read_text().splitlines()]
+
+
+def test_manufacturing_data(build_ctx, kicad_cli: Path, monkeypatch):
+    monkeypatch.setattr(utils, "_UMASK", 0o022)
+    manufacturing_data.generate_manufacturing_data(build_ctx)
+
+    exports = _exports(kicad_cli)
+    assert sorted(name for name, *_ in exports) == ["drill", "gerbers", "pos"]
+    # They all ran at once
+    assert max(start for _, start, _ in exports) < min(end for *_, end in exports)
+
+    with zipfile.ZipFile(build_ctx.build_path / "default-gerbers-nogit.zip") as zip_file:
+        names = [Path(name).name for name in zip_file.namelist()]
+    assert names == ["board-B_Cu.gbl", "board-F_Cu.gtl", "board.drl"]
+    # Readable by everyone, like the rest of the outputs
+    zip_path = build_ctx.build_path / "default-gerbers-nogit.zip"
+    assert stat.S_IMODE(zip_path.stat().st_mode) == 0o644
+
+    pos = (build_ctx.build_path / "default.pos.csv").read_text().splitlines()
+    assert pos[0] == "Designator,Value,Package,Mid X,Mid Y,Rotation,Layer"
+
+
+def test_unchanged_board_not_exported(build_ctx, kicad_cli: Path):
+    manufacturing_data.generate_manufacturing_data(build_ctx)
+    zip_path = build_ctx.build_path / "default-gerbers-nogit.zip"
+    zipped = zip_path.read_bytes()
+
+    manufacturing_data._ensure_modded_kicad_pcb_cache.clear()
+    manufacturing_data.generate_manufacturing_data(build_ctx)
+    assert len(_exports(kicad_cli)) == 3
+
+    # The archive's the same every time it's made
+    build_ctx.layout_path.write_text("(kicad_pcb changed {{GITHASH}})")
+    manufacturing_data._ensure_modded_kicad_pcb_cache.clear()
+    manufacturing_data.generate_manufacturing_data(build_ctx)
+    assert len(_exports(kicad_cli)) == 6
+    assert zip_path.read_bytes() == zipped
+
+
+def test_new_kicad_cli_exports_again(build_ctx, kicad_cli: Path, monkeypatch):
+    manufacturing_data.generate_manufacturing_data(build_ctx)
+    assert len(_exports(kicad_cli)) == 3
+
+    # The board's the same, but the exports might not be
+    monkeypatch.setattr(
+        manufacturing_data, "get_cli_version", lambda _: semver.Version(8, 0, 1)
+    )
+    manufacturing_data._ensure_modded_kicad_pcb_cache.clear()
+    manufacturing_data.generate_manufacturing_data(build_ctx)
+    assert len(_exports(kicad_cli)) == 6
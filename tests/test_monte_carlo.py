@@ -0,0 +1,90 @@
+import numpy as np
+import pytest
+
+from atopile import assertions
+from atopile.expressions import RangedValue
+from atopile.monte_carlo import SampledValue, simulate
+
+
+@pytest.fixture
+def entry(load_design):
+    file = load_design(
+        """
+        module Test:
+            a = 1V +/- 10%
+            b = 2V +/- 10%
+            c = a + b
+            assert a < b
+            assert c within 2.7V to 3.3V
+            assert a within 0.95V to 1.05V
+            assert c > 3V
+            assert a < 1.05V < b
+        """
+    )
+    return str(file) + ":Test"
+
+
+@pytest.mark.parametrize(
+    "a, b",
+    [
+        (RangedValue(1, 2), RangedValue(2, 3)),
+        (RangedValue(-1, 2), RangedValue(-3, -2)),
+        (RangedValue(1, 2, "mV"), RangedValue(1, 2, "V")),
+    ],
+)
+def test_arithmetic_matches_ranged_values(a: RangedValue, b: RangedValue):
+    sa = SampledValue._ensure(a)
+    sb = SampledValue._ensure(b)
+
+    for result, expected in [
+        (sa + sb, a + b),
+        (sa - sb, a - b),
+        (sa * sb, a * b),
+        (sa / sb, a / b),
+        (sa**2, a**2),
+        (-sa, -a),
+        (a + sb, a + b),
+        (a * sb, a * b),
+    ]:
+        assert isinstance(result, SampledValue)
+        assert result.min_qty.to(expected.unit).magnitude == pytest.approx(expected.min_val)
+        assert result.max_qty.to(expected.unit).magnitude == pytest.approx(expected.max_val)
+
+
+def test_comparitors():
+    samples = SampledValue(np.array([1.0, 2.0, 3.0]), unit="V")
+
+    assert list(samples < RangedValue(2, 3, "V")) == [True, False, False]
+    assert list(samples >= RangedValue(2, 2, "V")) == [False, True, True]
+    assert list(samples.within(RangedValue(1500, 2500, "mV"))) == [False, True, False]
+    # reflected, because SampledValue is a subclass of RangedValue
+    assert list(RangedValue(2, 2, "V") < samples) == [False, False, True]
+
+
+def test_simulate(entry):
+    results = simulate(entry, 10_000, "uniform")
+    yields = [r.yield_ for r in results]
+
+    assert len(yields) == 6
+    assert yields[0] == 1
+    assert yields[1] == 1
+    assert yields[2] == pytest.approx(0.5, abs=0.03)
+    assert yields[3] == pytest.approx(0.5, abs=0.03)
+    assert yields[4] == pytest.approx(0.75, abs=0.03)
+    assert yields[5] == 1
+
+
+def test_simulate_ignores_simplification(entry):
+    # Simplifying bakes the tolerances into the assertions, which would
+    # otherwise hide the variation from the samples
+    before = [r.yield_ for r in simulate(entry, 1_000)]
+    assertions.simplify_expressions(entry)
+    after = [r.yield_ for r in simulate(entry, 1_000)]
+
+    assert before == after
+
+
+def test_gaussian_is_tighter(entry):
+    uniform = simulate(entry, 10_000, "uniform")[2].yield_
+    gaussian = simulate(entry, 10_000, "gaussian")[2].yield_
+    assert gaussian > uniform
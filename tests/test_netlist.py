@@ -0,0 +1,96 @@
+import stat
+import textwrap
+from pathlib import Path
+from types import SimpleNamespace
+
+import pytest
+
+import atopile.cli.build
+from atopile import layout, netlist, utils
+
+
+@pytest.fixture
+def entry(load_design):
+    file = load_design(
+        """
+        component Resistor:
+            designator_prefix = "R"
+            footprint = "R0402"
+            mpn = "C25744"
+            value = "10k"
+            signal p1 ~ pin 1
+            signal p2 ~ pin 2
+
+        component Hole:
+            designator_prefix = "H"
+            footprint = "Holes:M3"
+            mpn = "M3"
+
+        module Test:
+            signal gnd
+            r1 = new Resistor
+            h1 = new Hole
+            r1.p2 ~ gnd
+        """,
+        "netlist.ato",
+    )
+    return str(file) + ":Test"
+
+
+def test_netlist(entry: str):
+    r1_uid = layout.generate_comp_uid(entry + "::r1")
+    h1_uid = layout.generate_comp_uid(entry + "::h1")
+
+    # The same, byte for byte, as we've always written
+    assert netlist.get_netlist_as_str(entry) == textwrap.dedent(
+        f"""\
+        (export (version "E")
+          (design
+            (source "unknown")
+            (date "")
+            (tool "atopile"))
+          (components
+            (comp (ref "R1")
+              (value "10k")
+              (footprint "lib:R0402")
+              (libsource (lib "lib") (part "C25744") (description "netlist.ato:Resistor"))
+              (sheetpath (names "{entry}::r1") (tstamps "{r1_uid}"))
+              (tstamps "{r1_uid}"))
+            (comp (ref "H1")
+              (value "")
+              (footprint "Holes:M3")
+              (libsource (lib "lib") (part "M3") (description "netlist.ato:Hole"))
+              (sheetpath (names "{entry}::h1") (tstamps "{h1_uid}"))
+              (tstamps "{h1_uid}")))
+          (libparts
+            (libpart (lib "lib") (part "C25744")
+              (description "netlist.ato:Resistor")
+              (docs "~")
+              (footprints
+                (fp "*"))
+              (pins
+                (pin (num "1") (name "1") (type "stereo"))
+                (pin (num "2") (name "2") (type "stereo"))))
+            (libpart (lib "lib") (part "M3")
+              (description "netlist.ato:Hole")
+              (docs "~")
+              (footprints
+                (fp "*")))))
+          (nets
+            (net (code "1") (name "gnd")
+              (node (ref "R1") (pin "2") (pintype "stereo")))
+            (net (code "2") (name "p1")
+              (node (ref "R1") (pin "1") (pintype "stereo")))))
+        """
+    )
+
+
+def test_netlist_target(entry: str, tmp_path: Path, monkeypatch):
+    monkeypatch.setattr(utils, "_UMASK", 0o022)
+    build_ctx = SimpleNamespace(entry=entry, output_base=tmp_path / "build" / "default")
+    atopile.cli.build.generate_netlist(build_ctx)
+
+    netlist_path = tmp_path / "build" / "default.net"
+    assert netlist_path.read_text(encoding="utf-8") == netlist.get_netlist_as_str(entry)
+    # Readable by everyone, like the rest of the outputs
+    assert stat.S_IMODE(netlist_path.stat().st_mode) == 0o644
@@ -0,0 +1,48 @@
+import gc
+import weakref
+from types import SimpleNamespace
+
+from atopile import overlay
+
+
+def test_cache_kept_on_overlay():
+    calls = []
+
+    @overlay.cache
+    def _double(x: int) -> int:
+        calls.append(x)
+        return x * 2
+
+    build = overlay.Overlay()
+    with overlay.activate(build):
+        assert _double(1) == 2
+        assert _double(1) == 2
+    assert calls == [1]
+
+    # Each overlay works its values out for itself
+    with overlay.activate(overlay.Overlay()):
+        assert _double(1) == 2
+    assert calls == [1, 1]
+
+    # ... and nothing's kept once the overlay's gone
+    build_ref = weakref.ref(build)
+    del build
+    gc.collect()
+    assert build_ref() is None
+
+
+def test_assignments_stacked():
+    source = [SimpleNamespace(value=1)]
+    instance = SimpleNamespace(assignments={"x": source, "y": []})
+    build = overlay.Overlay()
+
+    # What's not been stacked on is read straight from the model
+    assert build.get_assignments(instance, "x") is source
+    assert build.get_all_assignments(instance) is instance.assignments
+
+    solved = SimpleNamespace(name="x", value=2)
+    build.assign(instance, solved)
+    assert build.get_assignments(instance, "x") == [solved, *source]
+    assert build.get_assignments(instance, "y") is instance.assignments["y"]
+    assert build.get_all_assignments(instance) == {"x": [solved, *source], "y": []}
+    assert source == [SimpleNamespace(value=1)]
@@ -0,0 +1,79 @@
+import gzip
+import json
+from pathlib import Path
+
+import pytest
+
+from atopile.expressions import RangedValue
+from atopile.parts_index import PartsIndex, PartsIndexError
+
+
+def _part(lcsc_id: str, value: str, package: str = "0402", **kwargs) -> dict:
+    nominal, unit = value.split()
+    nominal = float(nominal)
+    return {
+        "lcsc_id": lcsc_id,
+        "type": "resistor",
+        "package": package,
+        "value": {"unit": unit, "min_val": nominal * 0.99, "max_val": nominal * 1.01},
+        **kwargs,
+    }
+
+
+PARTS = [
+    _part("C1", "10 kiloohm"),
+    _part("C2", "10000 ohm", basic=True),
+    _part("C3", "10 kiloohm", package="0603", basic=True),
+    _part("C4", "1 kiloohm", price=0.1),
+    _part("C5", "1000 ohm", price=0.01),
+    _part("C6", "1 kiloohm", voltage={"unit": "volt", "min_val": 50, "max_val": 50}),
+    {"lcsc_id": "C7", "type": "capacitor", "package": "0402"},
+]
+
+
+def _spec(value: RangedValue, **kwargs) -> dict:
+    return {"mpn": "generic_resistor", "type": "resistor", "value": value.to_dict(), **kwargs}
+
+
+@pytest.fixture
+def index():
+    return PartsIndex(PARTS)
+
+
+def test_find_by_value(index: PartsIndex):
+    # Values are compared in whatever units they're in
+    ten_k = RangedValue(9, 11, "kiloohm")
+    assert index.find(_spec(ten_k, package="0402"))["lcsc_id"] == "C2"
+    assert index.find(_spec(ten_k, package="0603"))["lcsc_id"] == "C3"
+    assert index.find(_spec(ten_k, package="0805")) is None
+
+    # Parts must be entirely within the spec
+    assert index.find(_spec(RangedValue(9.95, 11, "kiloohm"), package="0402")) is None
+
+
+def test_preference(index: PartsIndex):
+    # Basic parts first
+    assert index.find(_spec(RangedValue(9, 11, "kiloohm")))["lcsc_id"] == "C2"
+    # Then the cheapest
+    assert index.find(_spec(RangedValue(900, 1100, "ohm")))["lcsc_id"] == "C5"
+
+
+def test_other_attributes(index: PartsIndex):
+    spec = _spec(
+        RangedValue(900, 1100, "ohm"), voltage=RangedValue(25, 100, "volt").to_dict()
+    )
+    assert index.find(spec)["lcsc_id"] == "C6"
+
+    assert index.find({"type": "capacitor", "package": "0402"})["lcsc_id"] == "C7"
+    assert index.find({"type": "capacitor", "package": "0402", "dielectric": "X7R"}) is None
+
+
+def test_from_file(tmp_path: Path):
+    path = tmp_path / "parts.json.gz"
+    with gzip.open(path, "wt", encoding="utf-8") as f:
+        json.dump({"components": PARTS}, f)
+    assert len(PartsIndex.from_file(path)) == len(PARTS)
+
+    path.write_text("not json")
+    with pytest.raises(PartsIndexError):
+        PartsIndex.from_file(path)
@@ -0,0 +1,26 @@
+import os
+import stat
+from pathlib import Path
+
+from atopile import utils
+
+
+def _mode(path: Path) -> int:
+    return stat.S_IMODE(path.stat().st_mode)
+
+
+def test_atomic_open_follows_umask(tmp_path: Path, monkeypatch):
+    monkeypatch.setattr(utils, "_UMASK", 0o022)
+    path = tmp_path / "new.txt"
+    with utils.atomic_open(path) as f:
+        f.write("a")
+    assert _mode(path) == 0o644
+
+
+def test_atomic_open_keeps_mode(tmp_path: Path):
+    path = tmp_path / "existing.txt"
+    path.write_text("a")
+    os.chmod(path, 0o640)
+    assert utils.write_if_changed(path, b"b")
+    assert path.read_text() == "b"
+    assert _mode(path) == 0o640
@@ -0,0 +1,100 @@
+import pytest
+
+from atopile import assertions
+from atopile.expressions import RangedValue
+from atopile.worst_case import _Dual, find_worst_case
+
+
+@pytest.fixture
+def entry(load_design):
+    file = load_design(
+        """
+        module Test:
+            r1 = 10kohm +/- 10%
+            r2 = 10kohm +/- 10%
+            ratio = r2 / (r1 + r2)
+            v_in = 5V +/- 5%
+            v_out = v_in * ratio
+            assert ratio within 0.44 to 0.56
+            assert v_out < 3V
+            assert v_out > 2.5V
+            assert (r1 - 10kohm) / 1kohm * (r1 - 10kohm) / 1kohm < 2
+        """
+    )
+    return str(file) + ":Test"
+
+
+def _find_worst_cases(entry):
+    return [
+        find_worst_case(instance_addr, assertion)
+        for instance_addr, assertion in assertions.iter_source_assertions(entry)
+    ]
+
+
+def test_dual_arithmetic():
+    x = _Dual.leaf("x", (1, 2), RangedValue(1).unit)
+
+    # d/dx x / (x + 1) = 1 / (x + 1)^2
+    y = x / (x + 1)
+    assert y.grads["x"][0] >= 0
+
+    # d/dx (x - 1.5)^2 changes sign
+    z = (x - 1.5) ** 2
+    assert z.grads["x"][0] < 0 < z.grads["x"][1]
+    assert (z.min_val, z.max_val) == (0, 0.25)
+
+    # units are converted
+    v = _Dual.leaf("v", (1, 2), "V") + RangedValue(500, 500, "mV")
+    assert (v.min_val, v.max_val) == (1.5, 2.5)
+
+
+def test_less_pessimistic_than_intervals(entry):
+    ratio, *_ = _find_worst_cases(entry)
+
+    # Interval arithmetic says 0.409 to 0.611, but the ratio really
+    # only spans 0.45 to 0.55
+    assert ratio.passes
+    corner = {addr.split("::")[-1]: extreme for addr, (extreme, _) in ratio.corner.items()}
+    assert corner == {"r1": "max", "r2": "min"}
+
+
+def test_critical_corner(entry):
+    _, below, above, _ = _find_worst_cases(entry)
+
+    # Interval arithmetic says v_out could be as high as 3.21V
+    assert below.passes
+    corner = {addr.split("::")[-1]: extreme for addr, (extreme, _) in below.corner.items()}
+    assert corner == {"v_in": "max", "r1": "min", "r2": "max"}
+
+    assert not above.passes
+    corner = {addr.split("::")[-1]: extreme for addr, (extreme, _) in above.corner.items()}
+    assert corner == {"v_in": "min", "r1": "max", "r2": "min"}
+
+
+def test_monotonic_values_arent_enumerated(entry):
+    results = _find_worst_cases(entry)
+
+    # Monotonic margins take one evaluation to fix all the values, and
+    # another at the corner, regardless of how many values there are
+    assert [r.evaluations for r in results[:3]] == [4, 2, 2]
+
+    # Whereas non-monotonic ones need to have their extremes tried
+    assert results[3].evaluations > 2
+
+
+def test_min_max_of_literal_ranges(load_design):
+    file = load_design(
+        """
+        module Test:
+            v = 1V +/- 10%
+            assert min((v * 1 +/- 50%)) < 0.6V
+            assert max((v * 1 +/- 50%)) > 1.3V
+        """,
+        "min_max.ato",
+    )
+    low, high = _find_worst_cases(str(file) + ":Test")
+
+    # At v's worst corner, min() and max() pick out the ends of the literal's
+    # range, rather than keeping all of it
+    assert low.passes
+    assert high.passes